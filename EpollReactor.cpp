@@ -0,0 +1,197 @@
+#include "EpollReactor.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+
+#ifdef __linux__
+#    include <sys/epoll.h>
+
+static uint32_t epollEvents(bool readable, bool writable)
+{
+    return (readable ? static_cast<uint32_t>(EPOLLIN) : 0U) |
+        (writable ? static_cast<uint32_t>(EPOLLOUT) : 0U);
+}
+
+EpollReactor::EpollReactor() : epollFd(epoll_create1(EPOLL_CLOEXEC)) {}
+
+EpollReactor::~EpollReactor()
+{
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+}
+
+bool EpollReactor::add(int fd, handler_t onReadable, handler_t onWritable)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int flags = fcntl(fd, F_GETFL);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        return false;
+    }
+
+    struct epoll_event event = {};
+    event.events = epollEvents(static_cast<bool>(onReadable), false);
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return false;
+    }
+
+    watches[fd] = {std::move(onReadable), std::move(onWritable), false};
+    return true;
+}
+
+bool EpollReactor::wantWritable(int fd, bool enable)
+{
+    auto watch = watches.find(fd);
+    if (watch == watches.end()) {
+        errno = EBADF;
+        return false;
+    }
+    if (watch->second.writable == enable) {
+        return true;
+    }
+
+    struct epoll_event event = {};
+    event.events =
+        epollEvents(static_cast<bool>(watch->second.onReadable), enable);
+    event.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &event) < 0) {
+        return false;
+    }
+
+    watch->second.writable = enable;
+    return true;
+}
+
+int EpollReactor::poll(int timeoutMs)
+{
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    std::array<struct epoll_event, 16> events{};
+    int count = epoll_wait(epollFd, events.data(), events.size(), timeoutMs);
+    for (int i = 0; i < count; i++) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        const struct epoll_event &event = events[i];
+        auto watch = watches.find(event.data.fd);
+        if (watch == watches.end()) {
+            continue;
+        }
+
+        // Errors and hangups go to the handlers, their read or write fails
+        uint32_t failed = EPOLLERR | EPOLLHUP;
+        if ((event.events & (EPOLLOUT | failed)) != 0 &&
+            watch->second.writable && watch->second.onWritable) {
+            watch->second.onWritable();
+        }
+        if ((event.events & (EPOLLIN | failed)) != 0 &&
+            watch->second.onReadable) {
+            watch->second.onReadable();
+        }
+    }
+    return count;
+}
+
+#else
+
+EpollReactor::EpollReactor() = default;
+EpollReactor::~EpollReactor() = default;
+
+bool EpollReactor::add(int /*fd*/, handler_t /*onReadable*/,
+                       handler_t /*onWritable*/)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+bool EpollReactor::wantWritable(int /*fd*/, bool /*enable*/)
+{
+    errno = ENOSYS;
+    return false;
+}
+
+int EpollReactor::poll(int /*timeoutMs*/)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
+
+WriteQueue::WriteQueue(EpollReactor &_reactor, int _fd, size_t _maxFrames)
+    : reactor(_reactor), fd(_fd), maxFrames(_maxFrames)
+{}
+
+bool WriteQueue::write(const void *data, size_t length)
+{
+    struct iovec iov = {const_cast<void *>(data), length};
+    return write(&iov, 1);
+}
+
+bool WriteQueue::write(const struct iovec *iov, size_t iovCount)
+{
+    size_t length = 0;
+    for (size_t i = 0; i < iovCount; i++) {
+        length += iov[i].iov_len;
+    }
+
+    // Nothing queued, try to write it at once
+    size_t written = 0;
+    if (frames.empty()) {
+        ssize_t result = writev(fd, iov, static_cast<int>(iovCount));
+        if (result < 0 && errno != EAGAIN && errno != EINTR) {
+            dropCount++;
+            return false;
+        }
+        written = (result < 0) ? 0 : static_cast<size_t>(result);
+        if (written == length) {
+            return true;
+        }
+    }
+    // A frame started on the fd has to be finished, whatever the queue size
+    if (written == 0 && frames.size() >= maxFrames) {
+        dropCount++;
+        return false;
+    }
+
+    // Queue the rest of the frame
+    std::vector<char> frame;
+    frame.reserve(length - written);
+    for (size_t i = 0; i < iovCount; i++) {
+        const auto *base = static_cast<const char *>(iov[i].iov_base);
+        size_t skip = std::min(written, iov[i].iov_len);
+        frame.insert(frame.end(), base + skip, base + iov[i].iov_len);
+        written -= skip;
+    }
+    frames.push_back(std::move(frame));
+    reactor.wantWritable(fd, true);
+    return true;
+}
+
+void WriteQueue::flush()
+{
+    while (!frames.empty()) {
+        const std::vector<char> &frame = frames.front();
+        ssize_t result =
+            ::write(fd, frame.data() + offset, frame.size() - offset);
+        if (result < 0) {
+            if (errno == EAGAIN || errno == EINTR) {
+                return;
+            }
+            // The fd failed, drop the frame
+            dropCount++;
+            result = static_cast<ssize_t>(frame.size() - offset);
+        }
+
+        offset += static_cast<size_t>(result);
+        if (offset < frame.size()) {
+            return;
+        }
+        frames.pop_front();
+        offset = 0;
+    }
+    reactor.wantWritable(fd, false);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+/**
+ * @file Single-threaded epoll event loop with per-fd write queues
+ *
+ * All fds are non-blocking. A readable fd calls its handler, which reads
+ * until EAGAIN. Writes go through a WriteQueue: they are tried at once and
+ * only what the fd does not take is queued, EPOLLOUT is enabled while the
+ * queue is not empty.
+ */
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class EpollReactor
+{
+public:
+    typedef std::function<void()> handler_t;
+
+    EpollReactor();
+    ~EpollReactor();
+
+    EpollReactor(const EpollReactor &) = delete;
+    EpollReactor &operator=(const EpollReactor &) = delete;
+    EpollReactor(EpollReactor &&) = delete;
+    EpollReactor &operator=(EpollReactor &&) = delete;
+
+    /* false if epoll_create1() failed */
+    bool valid() const { return epollFd >= 0; }
+
+    /**
+     * Watch a fd, it is switched to non-blocking mode
+     * @param onReadable        Called when the fd is readable, may be empty
+     * @param onWritable        Called when the fd is writable and writes
+     *                          are wanted, may be empty
+     * @return false on error
+     */
+    bool add(int fd, handler_t onReadable, handler_t onWritable = nullptr);
+
+    /* Enable or disable EPOLLOUT for a watched fd */
+    bool wantWritable(int fd, bool enable);
+
+    /**
+     * Wait for events and call the handlers
+     * @param timeoutMs         -1 to wait until an event or a signal
+     * @return Number of events, or -1 with errno set (EINTR on a signal)
+     */
+    int poll(int timeoutMs);
+
+private:
+    struct Watch
+    {
+        handler_t onReadable;
+        handler_t onWritable;
+        bool writable;
+    };
+
+    int epollFd = -1;
+    std::unordered_map<int, Watch> watches;
+};
+
+/**
+ * Frames waiting for a non-blocking fd. Each frame is one write (or
+ * writev), a frame the fd took only partly is finished before the next.
+ */
+class WriteQueue
+{
+public:
+    /**
+     * @param fd                Watched by reactor
+     * @param maxFrames         New frames for a full queue are dropped
+     *                          (tail drop)
+     */
+    WriteQueue(EpollReactor &reactor, int fd, size_t maxFrames = 256);
+
+    /**
+     * Write one frame made of the iovec pieces
+     * @return false if the frame is dropped or the fd failed
+     */
+    bool write(const struct iovec *iov, size_t iovCount);
+    bool write(const void *data, size_t length);
+
+    /* Write what is queued, the reactor calls it on EPOLLOUT */
+    void flush();
+
+    /* Frames queued, not yet written */
+    size_t size() const { return frames.size(); }
+
+    /* Frames dropped so far (queue full or write error) */
+    size_t dropped() const { return dropCount; }
+
+private:
+    EpollReactor &reactor;
+    const int fd;
+    const size_t maxFrames;
+    std::deque<std::vector<char>> frames;
+    size_t offset = 0; // written part of the first frame
+    size_t dropCount = 0;
+};
@@ -0,0 +1,103 @@
+#include "ExtensionChain.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+/* Move batches from one stage to the next until io_cancel() */
+void forward(const ExtensionChain::stage_t &from,
+             ExtensionPoint::Channel fromChannel,
+             const ExtensionChain::stage_t &to,
+             ExtensionPoint::Channel toChannel, size_t packetLength)
+{
+    PacketBatch batch(packetLength);
+    while (io_is_enabled()) {
+        ssize_t packets = from->readBatch(fromChannel, batch.reset());
+        if (packets < 0 && (errno == ECANCELED || errno == EPIPE)) {
+            break;
+        }
+        if (packets <= 0) {
+            SPDLOG_ERROR("Chain read error({}) {}", errno, strerror(errno));
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        ssize_t written = to->writeBatch(
+            toChannel, batch.first(static_cast<size_t>(packets)));
+        if (written != packets) {
+            SPDLOG_ERROR("Chain write error({}) {}, {} packets dropped", errno,
+                         strerror(errno),
+                         packets - std::max<ssize_t>(written, 0));
+        }
+    }
+    SPDLOG_INFO("Chain forwarder stopped");
+}
+
+/* Same with packet references, one packet at a time */
+void forwardPackets(const ExtensionChain::stage_t &from,
+                    ExtensionPoint::Channel fromChannel,
+                    const ExtensionChain::stage_t &to,
+                    ExtensionPoint::Channel toChannel,
+                    const std::shared_ptr<PacketPool> &pool)
+{
+    while (io_is_enabled()) {
+        PacketRef packet = from->readPacket(fromChannel, *pool);
+        if (!packet && (errno == ECANCELED || errno == EPIPE)) {
+            break;
+        }
+        if (!packet) {
+            SPDLOG_ERROR("Chain read error({}) {}", errno, strerror(errno));
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            continue;
+        }
+
+        if (!to->writePacket(toChannel, std::move(packet))) {
+            SPDLOG_ERROR("Chain write error({}) {}, packet dropped", errno,
+                         strerror(errno));
+        }
+    }
+    SPDLOG_INFO("Chain forwarder stopped");
+}
+
+/* One thread moving packets from one stage to the next */
+std::thread forwarder(const ExtensionChain::stage_t &from,
+                      ExtensionPoint::Channel fromChannel,
+                      const ExtensionChain::stage_t &to,
+                      ExtensionPoint::Channel toChannel, size_t packetLength,
+                      const std::shared_ptr<PacketPool> &pool)
+{
+    if (pool) {
+        return std::thread(forwardPackets, from, fromChannel, to, toChannel,
+                           pool);
+    }
+    return std::thread(forward, from, fromChannel, to, toChannel,
+                       packetLength);
+}
+
+} // namespace
+
+ExtensionChain::ExtensionChain(std::vector<stage_t> _stages,
+                               size_t packetLength, int firstCore,
+                               std::shared_ptr<PacketPool> pool)
+    : stages(std::move(_stages))
+{
+    Expects(!stages.empty());
+
+    // NOTE: the forwarders own their stages, they may block in read()
+    // after the chain is gone, as readInBound() and readOutBound() do
+    for (size_t i = 0; i + 1 < stages.size(); i++) {
+        std::thread outer = forwarder(stages[i], INNER, stages[i + 1], OUTER,
+                                      packetLength, pool);
+        std::thread inner = forwarder(stages[i + 1], OUTER, stages[i], INNER,
+                                      packetLength, pool);
+        if (firstCore >= 0) {
+            unsigned core = static_cast<unsigned>(firstCore) + i;
+            (void)pin_thread(outer.native_handle(), core);
+            (void)pin_thread(inner.native_handle(), core);
+        }
+        outer.detach();
+        inner.detach();
+    }
+}
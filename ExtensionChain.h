@@ -0,0 +1,81 @@
+#pragma once
+
+/**
+ * @file ExtensionPoint stages composed in order
+ *
+ * A stage works like Pipe: what is written to OUTER is read from INNER
+ * after its processing, and the other way round. The chain writes OUTER to
+ * the first stage and INNER to the last one. Between two stages there is
+ * one forwarder thread per direction. It moves batches on, so each stage's
+ * processing runs on its own thread, and can run on its own core. The
+ * stages' buffers bound the queues between them. With a PacketPool the
+ * forwarders pass packet references on, RingPipe stages on the same pool
+ * then do not copy the packets.
+ */
+
+#include "ExtensionPoint.h"
+
+#include <memory>
+#include <vector>
+
+// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
+class ExtensionChain : public ExtensionPoint
+{
+public:
+    typedef std::shared_ptr<ExtensionPoint> stage_t;
+
+    /**
+     * Start the forwarders, they run until io_cancel()
+     * @param stages        From the OUTER (serial) to the INNER (TAP) side,
+     *                      at least one
+     * @param packetLength  Longest packet
+     * @param firstCore     Core of the first pair of forwarders, the next
+     *                      pair gets the next core. -1 does not pin them.
+     * @param pool          Buffers for readPacket(), nullptr copies batches
+     */
+    ExtensionChain(std::vector<stage_t> stages, size_t packetLength,
+                   int firstCore = -1,
+                   std::shared_ptr<PacketPool> pool = nullptr);
+
+    ssize_t read(Channel id, void *buf, size_t count) noexcept override
+    {
+        return end(id).read(id, buf, count);
+    }
+    ssize_t write(Channel id, const void *buf, size_t count) noexcept override
+    {
+        return end(id).write(id, buf, count);
+    }
+    ssize_t readBatch(Channel id, gsl::span<Packet> packets) noexcept override
+    {
+        return end(id).readBatch(id, packets);
+    }
+    ssize_t writeBatch(Channel id,
+                       gsl::span<const Packet> packets) noexcept override
+    {
+        return end(id).writeBatch(id, packets);
+    }
+    bool writePacket(Channel id, PacketRef packet) noexcept override
+    {
+        return end(id).writePacket(id, std::move(packet));
+    }
+    PacketRef readPacket(Channel id, PacketPool &pool) noexcept override
+    {
+        return end(id).readPacket(id, pool);
+    }
+    int fileno(Channel id) const noexcept override
+    {
+        return end(id).fileno(id);
+    }
+
+    /* Number of stages */
+    size_t size() const { return stages.size(); }
+
+private:
+    // OUTER is the first stage's, INNER the last one's
+    ExtensionPoint &end(Channel id) const
+    {
+        return (id == OUTER) ? *stages.front() : *stages.back();
+    }
+
+    std::vector<stage_t> stages;
+};
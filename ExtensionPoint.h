@@ -1,11 +1,17 @@
 #pragma once
 
+#include "PacketPool.h"
+#include "SpscRing.h"
 #include "tun-driver.h"
 
 // XXX #include <boost/core/noncopyable.hpp>
 
+#include <algorithm>
 #include <array>
 #include <cerrno>
+#include <cstring>
+#include <memory>
+#include <vector>
 
 class ExtensionPoint
 {
@@ -24,10 +30,95 @@ public:
 
     virtual ~ExtensionPoint() = default;
 
+    /* One packet of a batch, readBatch() sets count from the buffer size to
+     * the packet length */
+    struct Packet
+    {
+        void *buf;
+        size_t count;
+    };
+
+    /* Largest batch the forwarding loops pass */
+    static constexpr size_t MAX_BATCH = 16;
+
     virtual ssize_t read(Channel fd, void *buf, size_t count) noexcept = 0;
     virtual ssize_t write(Channel fd, const void *buf,
                           size_t count) noexcept = 0;
 
+    /**
+     * Read up to packets.size() packets, waits for the first one only. The
+     * default reads one packet, a second read() could block.
+     * @return Number of packets read, 0 at end of file or -1 with errno set
+     */
+    virtual ssize_t readBatch(Channel fd, gsl::span<Packet> packets) noexcept
+    {
+        if (packets.empty()) {
+            return 0;
+        }
+        ssize_t count = read(fd, packets[0].buf, packets[0].count);
+        if (count <= 0) {
+            return count;
+        }
+        packets[0].count = static_cast<size_t>(count);
+        return 1;
+    }
+
+    /**
+     * Write the packets in order, stops at the first one that fails
+     * @return Number of packets written, -1 with errno set if none was
+     */
+    virtual ssize_t writeBatch(Channel fd,
+                               gsl::span<const Packet> packets) noexcept
+    {
+        ssize_t done = 0;
+        for (const Packet &packet : packets) {
+            if (write(fd, packet.buf, packet.count) !=
+                static_cast<ssize_t>(packet.count)) {
+                break;
+            }
+            done++;
+        }
+        return (done == 0 && !packets.empty()) ? -1 : done;
+    }
+
+    /**
+     * Hand a packet on by reference, an extension that keeps packets in
+     * memory passes the buffer without a copy. The default write()s it.
+     * @return false with errno set if the packet was not taken
+     */
+    virtual bool writePacket(Channel fd, PacketRef packet) noexcept
+    {
+        return write(fd, packet.data(), packet.length()) ==
+            static_cast<ssize_t>(packet.length());
+    }
+
+    /**
+     * Next packet by reference. The default read()s it into a buffer of
+     * pool, an extension that keeps packets in memory returns its buffer.
+     * @return empty with errno set on error (ENOBUFS if pool has no buffer
+     *         left), or with errno 0 at end of file
+     */
+    virtual PacketRef readPacket(Channel fd, PacketPool &pool) noexcept
+    {
+        PacketRef packet = pool.allocate();
+        if (!packet) {
+            errno = ENOBUFS;
+            return {};
+        }
+        ssize_t count = read(fd, packet.data(), packet.capacity());
+        if (count <= 0) {
+            if (count == 0) {
+                errno = 0;
+            }
+            return {};
+        }
+        packet.setLength(static_cast<size_t>(count));
+        return packet;
+    }
+
+    /* fd to poll for this channel, -1 if the extension has none */
+    virtual int fileno(Channel /*fd*/) const noexcept { return -1; }
+
 protected:
     ExtensionPoint() = default;
 };
@@ -38,9 +129,17 @@ class Pipe : public ExtensionPoint // XXX , private boost::noncopyable
 public:
     Pipe()
     {
+#ifdef __linux__
+        // Keeps the packet boundaries, one read() returns one packet
+        if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fd.data()) <
+            0) {
+            SPDLOG_ERROR("socketpair() error({}) {}", errno, strerror(errno));
+        }
+#else
         if (pipe_open(fd.data()) < 0) {
             SPDLOG_ERROR("pipe_open() error({}) {}", errno, strerror(errno));
         }
+#endif
     }
 
     ~Pipe() override
@@ -59,7 +158,326 @@ public:
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
         return ::write(fd[id], buf, count);
     }
+    int fileno(Channel id) const noexcept override
+    {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        return fd[id];
+    }
+
+#ifdef __linux__
+    /* One recvmmsg() for the batch, truncated packets are dropped */
+    ssize_t readBatch(Channel id, gsl::span<Packet> packets) noexcept override
+    {
+        std::array<struct iovec, MAX_BATCH> iov{};
+        std::array<struct mmsghdr, MAX_BATCH> msgs{};
+        size_t count = std::min(packets.size(), MAX_BATCH);
+        for (size_t i = 0; i < count; i++) {
+            iov[i] = {packets[i].buf, packets[i].count};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        int result = recvmmsg(fd[id], msgs.data(), count, MSG_WAITFORONE,
+                              nullptr);
+        int kept = 0;
+        for (int i = 0; i < result; i++) {
+            if ((msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0) {
+                SPDLOG_ERROR("packet longer than {} dropped", iov[i].iov_len);
+                continue;
+            }
+            packets[kept++] = {iov[i].iov_base, msgs[i].msg_len};
+        }
+        if (result > 0 && kept == 0) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        return (result < 0) ? result : kept;
+    }
+
+    /* One sendmmsg() for the batch */
+    ssize_t writeBatch(Channel id,
+                       gsl::span<const Packet> packets) noexcept override
+    {
+        std::array<struct iovec, MAX_BATCH> iov{};
+        std::array<struct mmsghdr, MAX_BATCH> msgs{};
+        size_t count = std::min(packets.size(), MAX_BATCH);
+        for (size_t i = 0; i < count; i++) {
+            iov[i] = {packets[i].buf, packets[i].count};
+            msgs[i].msg_hdr.msg_iov = &iov[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        return sendmmsg(fd[id], msgs.data(), count, 0);
+    }
+#endif
 
 private:
     std::array<int, 2> fd{{-1, -1}};
 };
+
+/**
+ * Same as Pipe without the kernel: the packets are copied through one
+ * SpscRing per direction, no syscall unless a side has to sleep. There may
+ * be one writer and one reader per channel, and no fileno() to poll.
+ *
+ * With a PacketPool the rings carry references to its buffers instead,
+ * writePacket() and readPacket() hand a packet on without a copy.
+ */
+// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
+class RingPipe : public ExtensionPoint
+{
+public:
+    /* Packets in flight per direction */
+    static constexpr size_t RING_SLOTS = 64;
+
+    // How long a side sleeps before it checks io_is_enabled()
+    static constexpr int WAIT_SLICE_MS = 100;
+
+    explicit RingPipe(size_t packetLength, size_t slotCount = RING_SLOTS)
+    {
+        makeRings(slotCount, packetLength);
+    }
+
+    /* read() and write() copy from and into buffers of pool */
+    explicit RingPipe(std::shared_ptr<PacketPool> pool,
+                      size_t slotCount = RING_SLOTS)
+        : packetPool(std::move(pool))
+    {
+        makeRings(slotCount, sizeof(void *));
+    }
+
+    ~RingPipe() override
+    {
+        // Drop the references still in flight
+        void *released = nullptr;
+        for (size_t i = 0; packetPool && i < rings.size(); i++) {
+            while (rings[i]->pop(&released, sizeof(released), 0) >= 0) {
+                PacketRef::adopt(released).reset();
+            }
+        }
+    }
+
+    ssize_t read(Channel id, void *buf, size_t count) noexcept override
+    {
+        return retry([&](int timeoutMs) {
+            return pop(id, buf, count, timeoutMs);
+        });
+    }
+    ssize_t write(Channel id, const void *buf, size_t count) noexcept override
+    {
+        if (!packetPool) {
+            return retry([&](int timeoutMs) {
+                return to(id).push(buf, count, timeoutMs);
+            });
+        }
+
+        // A full pool drops the packet, as a full ring buffer of a NIC
+        if (count > packetPool->capacity()) {
+            errno = EMSGSIZE;
+            return -1;
+        }
+        PacketRef packet = packetPool->allocate();
+        if (!packet) {
+            errno = ENOBUFS;
+            return -1;
+        }
+        memcpy(packet.data(), buf, count);
+        packet.setLength(count);
+        return writePacket(id, std::move(packet))
+            ? static_cast<ssize_t>(count)
+            : -1;
+    }
+
+    /* Waits for the first packet, takes the others that are there */
+    ssize_t readBatch(Channel id, gsl::span<Packet> packets) noexcept override
+    {
+        if (packets.empty()) {
+            return 0;
+        }
+        ssize_t count = read(id, packets[0].buf, packets[0].count);
+        if (count < 0) {
+            return -1;
+        }
+        packets[0].count = static_cast<size_t>(count);
+
+        ssize_t done = 1;
+        for (; done < static_cast<ssize_t>(packets.size()); done++) {
+            Packet &packet = packets[done];
+            count = pop(id, packet.buf, packet.count, 0);
+            if (count < 0) {
+                break;
+            }
+            packet.count = static_cast<size_t>(count);
+        }
+        return done;
+    }
+
+    bool writePacket(Channel id, PacketRef packet) noexcept override
+    {
+        if (!packetPool) {
+            return ExtensionPoint::writePacket(id, std::move(packet));
+        }
+
+        void *released = packet.release();
+        if (retry([&](int timeoutMs) {
+                return to(id).push(&released, sizeof(released), timeoutMs);
+            }) < 0) {
+            PacketRef::adopt(released).reset();
+            return false;
+        }
+        return true;
+    }
+    PacketRef readPacket(Channel id, PacketPool &pool) noexcept override
+    {
+        if (!packetPool) {
+            return ExtensionPoint::readPacket(id, pool);
+        }
+
+        void *released = nullptr;
+        if (retry([&](int timeoutMs) {
+                return from(id).pop(&released, sizeof(released), timeoutMs);
+            }) < 0) {
+            return {};
+        }
+        return PacketRef::adopt(released);
+    }
+
+protected:
+    /* The subclass sets up the rings */
+    RingPipe() = default;
+
+    /* Checked while a side waits, false once the other side is gone */
+    virtual bool connected() const noexcept { return true; }
+
+    std::vector<std::unique_ptr<SpscRing>> rings;
+    std::array<SpscRing *, 2> toRing{};   // written by write(channel)
+    std::array<SpscRing *, 2> fromRing{}; // read by read(channel)
+
+private:
+    void makeRings(size_t slotCount, size_t slotSize)
+    {
+        // write(OUTER) is read(INNER) and the other way round, as with Pipe
+        rings.push_back(std::make_unique<SpscRing>(slotCount, slotSize));
+        rings.push_back(std::make_unique<SpscRing>(slotCount, slotSize));
+        toRing = {{rings[OUTER].get(), rings[INNER].get()}};
+        fromRing = {{rings[INNER].get(), rings[OUTER].get()}};
+    }
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    SpscRing &to(Channel id) { return *toRing[id]; }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+    SpscRing &from(Channel id) { return *fromRing[id]; }
+
+    /* One packet copied out of the ring, or out of its pool buffer */
+    ssize_t pop(Channel id, void *buf, size_t count, int timeoutMs) noexcept
+    {
+        if (!packetPool) {
+            return from(id).pop(buf, count, timeoutMs);
+        }
+        void *released = nullptr;
+        if (from(id).pop(&released, sizeof(released), timeoutMs) < 0) {
+            return -1;
+        }
+        PacketRef packet = PacketRef::adopt(released);
+        size_t length = std::min(count, packet.length());
+        memcpy(buf, packet.data(), length);
+        return static_cast<ssize_t>(length);
+    }
+
+    /* Wait slice by slice until io_cancel() or the other side is gone */
+    template <typename Operation> ssize_t retry(Operation &&operation)
+    {
+        while (io_is_enabled()) {
+            ssize_t result = operation(WAIT_SLICE_MS);
+            if (result >= 0 || errno != ETIMEDOUT) {
+                return result;
+            }
+            if (!connected()) {
+                errno = EPIPE;
+                return -1;
+            }
+        }
+        errno = ECANCELED;
+        return -1;
+    }
+
+    std::shared_ptr<PacketPool> packetPool;
+};
+
+/* The extension type of a CommDevices without one, nothing calls it */
+struct NoExtension
+{
+    typedef ExtensionPoint::Channel Channel;
+
+    ssize_t read(Channel /*fd*/, void * /*buf*/, size_t /*count*/) noexcept
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    ssize_t write(Channel /*fd*/, const void * /*buf*/,
+                  size_t /*count*/) noexcept
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    ssize_t readBatch(Channel /*fd*/,
+                      gsl::span<ExtensionPoint::Packet> /*packets*/) noexcept
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    ssize_t
+    writeBatch(Channel /*fd*/,
+               gsl::span<const ExtensionPoint::Packet> /*packets*/) noexcept
+    {
+        errno = ENOSYS;
+        return -1;
+    }
+    bool writePacket(Channel /*fd*/, PacketRef /*packet*/) noexcept
+    {
+        errno = ENOSYS;
+        return false;
+    }
+    PacketRef readPacket(Channel /*fd*/, PacketPool & /*pool*/) noexcept
+    {
+        errno = ENOSYS;
+        return {};
+    }
+    int fileno(Channel /*fd*/) const noexcept { return -1; }
+};
+
+/* Buffers for ExtensionPoint::readBatch(), allocated once per loop */
+class PacketBatch
+{
+public:
+    explicit PacketBatch(size_t packetLength,
+                         size_t size = ExtensionPoint::MAX_BATCH)
+        : storage(packetLength * size), packets(size), length(packetLength)
+    {}
+
+    /* All buffers, with their full size, for the next readBatch() */
+    gsl::span<ExtensionPoint::Packet> reset()
+    {
+        for (size_t i = 0; i < packets.size(); i++) {
+            packets[i] = {storage.data() + i * length, length};
+        }
+        return packets;
+    }
+
+    /* The first count packets of the last readBatch(), for writeBatch() */
+    gsl::span<const ExtensionPoint::Packet> first(size_t count) const
+    {
+        return {packets.data(), count};
+    }
+
+    /* Packet i of the last readBatch() */
+    const ExtensionPoint::Packet &operator[](size_t i) const
+    {
+        return packets[i];
+    }
+
+private:
+    std::vector<char> storage;
+    std::vector<ExtensionPoint::Packet> packets;
+    const size_t length;
+};
@@ -0,0 +1,105 @@
+#include "FrameReader.h"
+
+#include <arpa/inet.h>
+#include <cstring>
+
+// Room for two whole frames, a read is never limited to less than one
+FrameReader::FrameReader(size_t _maxFrameLength)
+    : buffer(2 * MAX_TRANSFER),
+      maxFrameLength(_maxFrameLength)
+{}
+
+ssize_t FrameReader::fill(int fd)
+{
+    size_t length = 0;
+    char *free = space(&length);
+    ssize_t count = ::read(fd, free, length);
+    if (count > 0) {
+        commit(static_cast<size_t>(count));
+    }
+    return count;
+}
+
+char *FrameReader::space(size_t *length)
+{
+    // Move the partial frame to the front when the rest may not fit
+    if (head == tail) {
+        head = tail = 0;
+    } else if (buffer.size() - tail < MAX_TRANSFER) {
+        memmove(buffer.data(), buffer.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+
+    *length = buffer.size() - tail;
+    return buffer.data() + tail;
+}
+
+void FrameReader::commit(size_t count)
+{
+    Expects(count <= buffer.size() - tail);
+    tail += count;
+}
+
+bool FrameReader::next(const char **frame, size_t *length)
+{
+    if (piecesDone) {
+        pieces.clear();
+        piecesDone = false;
+    }
+
+    while (tail - head >= sizeof(uint16_t)) {
+        uint16_t hdr = 0;
+        memcpy(&hdr, buffer.data() + head, sizeof(hdr));
+        hdr = ntohs(hdr); // NOLINT
+        size_t flen = hdr & ETHER_FRAME_LEN_MASK;
+        if (tail - head - sizeof(hdr) < flen) {
+            return false; // the payload is not complete yet
+        }
+
+        const char *data = buffer.data() + head + sizeof(hdr);
+        head += sizeof(hdr) + flen;
+        bool more = (hdr & ETHER_FRAME_MORE) != 0;
+
+        // A whole frame, handed out from the buffer
+        if (!more && pieces.empty() && !dropping) {
+            if (flen == 0) {
+                continue;
+            }
+            if (flen > maxFrameLength) {
+                SPDLOG_ERROR("frame longer than {}", maxFrameLength);
+                errorCount++;
+                continue;
+            }
+            *frame = data;
+            *length = flen;
+            frameCount++;
+            return true;
+        }
+
+        // A piece of a super-frame, see frame_write_segmented()
+        if (!dropping && pieces.size() + flen > maxFrameLength) {
+            SPDLOG_ERROR("segmented frame longer than {}", maxFrameLength);
+            errorCount++;
+            pieces.clear();
+            dropping = true;
+        }
+        if (!dropping) {
+            pieces.insert(pieces.end(), data, data + flen);
+        }
+        if (more) {
+            continue;
+        }
+        if (dropping) {
+            dropping = false;
+            continue;
+        }
+
+        *frame = pieces.data();
+        *length = pieces.size();
+        piecesDone = true;
+        frameCount++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+/**
+ * @file Length header frames from a byte stream
+ *
+ * frame_read() needs one readv() to return exactly one [len16][payload]
+ * frame. A tty or SPI device returns what it has, a frame may come in pieces
+ * and one read may hold many frames. FrameReader reads as much as the fd
+ * has and hands out every complete frame, a partial header or payload stays
+ * in the buffer for the next read.
+ */
+
+#include "tun-driver.h"
+
+#include <vector>
+
+class FrameReader
+{
+public:
+    /* Largest transfer one fill() is sure to take whole, a longer datagram
+     * would be cut */
+    static constexpr size_t MAX_TRANSFER =
+        sizeof(uint16_t) + ETHER_FRAME_LEN_MASK;
+
+    /**
+     * @param maxFrameLength    Longer frames are dropped, super-frames made
+     *                          of ETHER_FRAME_MORE pieces included
+     */
+    explicit FrameReader(size_t maxFrameLength = ETHER_FRAME_LENGTH);
+
+    /**
+     * One read() into the free part of the buffer, frames returned by
+     * next() before are invalid afterwards
+     * @return Bytes read, 0 at end of file or -1 with errno set
+     */
+    ssize_t fill(int fd);
+
+    /**
+     * Same as fill() for a read the caller makes, io_uring for example:
+     * the free part of the buffer, frames returned by next() before are
+     * invalid afterwards
+     * @param length    Set to the bytes free at the returned pointer
+     */
+    char *space(size_t *length);
+
+    /* count bytes were read into space() */
+    void commit(size_t count);
+
+    /**
+     * Next complete frame in the buffer, a super-frame is joined
+     * @param frame     Set to the payload, valid until the next next() or
+     *                  fill()
+     * @param length    Set to the payload length
+     * @return false if the buffer holds no complete frame
+     */
+    bool next(const char **frame, size_t *length);
+
+    /**
+     * Read and hand every complete frame to onFrame(frame, length)
+     * @return Same as fill()
+     */
+    template <typename Callback>
+    ssize_t read(int fd, Callback &&onFrame)
+    {
+        ssize_t count = fill(fd);
+        const char *frame = nullptr;
+        size_t length = 0;
+        while (next(&frame, &length)) {
+            onFrame(frame, length);
+        }
+        return count;
+    }
+
+    /* true if the last frame of next() was joined from pieces, it is gone
+     * with the next call of next() */
+    bool joined() const { return piecesDone; }
+
+    /* Bytes waiting for the rest of their frame */
+    size_t buffered() const { return tail - head; }
+
+    /* Frames found so far */
+    size_t frames() const { return frameCount; }
+
+    /* Frames dropped so far (too long) */
+    size_t errors() const { return errorCount; }
+
+private:
+    std::vector<char> buffer;
+    size_t head = 0; // first byte not handed out yet
+    size_t tail = 0; // end of the data read
+    const size_t maxFrameLength;
+
+    std::vector<char> pieces; // of the current super-frame
+    bool piecesDone = false;  // handed out, clear them on the next call
+    bool dropping = false;    // the current super-frame is too long
+
+    size_t frameCount = 0;
+    size_t errorCount = 0;
+};
@@ -0,0 +1,114 @@
+#include "FrameWriter.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstring>
+#include <sys/select.h>
+
+FrameWriter::FrameWriter(int _fd, size_t _maxTransfer,
+                         std::chrono::microseconds _maxDelay,
+                         std::mutex *_writeMutex)
+    : fd(_fd), maxTransfer(_maxTransfer), maxDelay(_maxDelay),
+      writeMutex(_writeMutex)
+{
+    batch.reserve(maxTransfer);
+}
+
+ssize_t FrameWriter::write(const char *frame, size_t length)
+{
+    const size_t flen = sizeof(uint16_t) + length;
+    if (length > ETHER_FRAME_LEN_MASK || flen > maxTransfer) {
+        if (flush() < 0) {
+            return -1;
+        }
+
+        std::unique_lock<std::mutex> lock;
+        if (writeMutex != nullptr) {
+            lock = std::unique_lock<std::mutex>(*writeMutex);
+        }
+        ssize_t result =
+            frame_write_segmented(fd, const_cast<char *>(frame), length);
+        if (result > 0) {
+            transferCount++;
+            frameCount++;
+        }
+        return result;
+    }
+
+    if (batch.size() + flen > maxTransfer && flush() < 0) {
+        return -1;
+    }
+    if (batch.empty()) {
+        deadline = clock::now() + maxDelay;
+    }
+
+    uint16_t hdr = htons(length); // NOLINT
+    const auto *hdrBytes = reinterpret_cast<const char *>(&hdr);
+    batch.insert(batch.end(), hdrBytes, hdrBytes + sizeof(hdr));
+    batch.insert(batch.end(), frame, frame + length);
+    batchFrames++;
+
+    // Full, or a frame came in after the deadline
+    if (batch.size() + sizeof(uint16_t) >= maxTransfer ||
+        clock::now() >= deadline) {
+        if (flush() < 0) {
+            return -1;
+        }
+    }
+    return static_cast<ssize_t>(flen);
+}
+
+ssize_t FrameWriter::flush()
+{
+    if (batch.empty()) {
+        return 0;
+    }
+
+    ssize_t result;
+    {
+        std::unique_lock<std::mutex> lock;
+        if (writeMutex != nullptr) {
+            lock = std::unique_lock<std::mutex>(*writeMutex);
+        }
+        result = write_n(fd, batch.data(), batch.size());
+    }
+    if (result > 0) {
+        transferCount++;
+        frameCount += batchFrames;
+    }
+    if (result >= 0 && static_cast<size_t>(result) != batch.size()) {
+        errno = EIO; // canceled in the middle
+        result = -1;
+    }
+
+    batch.clear();
+    batchFrames = 0;
+    return result;
+}
+
+bool FrameWriter::waitReadable(int readFd)
+{
+    if (batch.empty()) {
+        return true; // nothing is due, the read may block
+    }
+
+    auto timeout = std::chrono::duration_cast<std::chrono::microseconds>(
+        deadline - clock::now());
+    if (timeout.count() > 0) {
+        fd_set fdset;
+        FD_ZERO(&fdset);
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-constant-array-index)
+        FD_SET(readFd, &fdset);
+        struct timeval tv = {};
+        tv.tv_sec = static_cast<time_t>(timeout.count() / 1000000);
+        tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000000);
+        if (select(readFd + 1, &fdset, NULL, NULL, &tv) != 0) {
+            return true; // readable, or an error the read reports
+        }
+    }
+
+    if (flush() < 0) {
+        SPDLOG_ERROR("FrameWriter write error({}) {}", errno, strerror(errno));
+    }
+    return false;
+}
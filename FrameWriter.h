@@ -0,0 +1,71 @@
+#pragma once
+
+/**
+ * @file Length header frames packed into large transfers
+ *
+ * Every write to an SPI device is one transfer with a high fixed cost.
+ * FrameWriter collects [len16][payload] frames into one buffer and writes
+ * it when the next frame does not fit, or when the oldest frame waited
+ * maxDelay. The peer reads them with a FrameReader.
+ */
+
+#include "tun-driver.h"
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+class FrameWriter
+{
+public:
+    typedef std::chrono::steady_clock clock;
+
+    /**
+     * @param fd            Written with one write() per transfer
+     * @param maxTransfer   Largest transfer, frames with their headers
+     * @param maxDelay      Longest time a frame waits for more
+     * @param writeMutex    Held while writing, if the fd is shared
+     */
+    FrameWriter(int fd, size_t maxTransfer, std::chrono::microseconds maxDelay,
+                std::mutex *writeMutex = nullptr);
+
+    /**
+     * Add a frame to the transfer. A frame too large for a transfer is
+     * written on its own, split with frame_write_segmented().
+     * @return Frame length with headers, or -1 with errno set if a write
+     *         failed (the transfer is lost)
+     */
+    ssize_t write(const char *frame, size_t length);
+
+    /**
+     * Write the frames collected so far
+     * @return Bytes written, or -1 with errno set
+     */
+    ssize_t flush();
+
+    /**
+     * Wait until fd is readable, or until the collected frames are due and
+     * write them
+     * @return true if fd is readable
+     */
+    bool waitReadable(int fd);
+
+    /* Transfers written so far */
+    size_t transfers() const { return transferCount; }
+
+    /* Frames written so far */
+    size_t frames() const { return frameCount; }
+
+private:
+    const int fd;
+    const size_t maxTransfer;
+    const std::chrono::microseconds maxDelay;
+    std::mutex *writeMutex;
+
+    std::vector<char> batch;
+    size_t batchFrames = 0;
+    clock::time_point deadline; // of the first frame in the batch
+
+    size_t transferCount = 0;
+    size_t frameCount = 0;
+};
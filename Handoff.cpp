@@ -0,0 +1,184 @@
+#include "Handoff.h"
+
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+constexpr uint32_t HANDOFF_VERSION = 1;
+
+int handoff_address(const char *path, struct sockaddr_un *addr)
+{
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return 0;
+}
+
+} // namespace
+
+int handoff_listen(const char *path)
+{
+    struct sockaddr_un addr;
+    if (handoff_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    (void)unlink(path); // left over by an instance that died
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+            0 ||
+        listen(fd, 1) < 0) {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return -1;
+    }
+    return fd;
+}
+
+int handoff_take(const char *path, int *sock, struct handoff_state *state,
+                 int *fds, size_t maxFds)
+{
+    struct sockaddr_un addr;
+    if (handoff_address(path, &addr) < 0) {
+        return -1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) < 0) {
+        int err = errno;
+        close(fd);
+        if (err == ENOENT || err == ECONNREFUSED) {
+            return 0; // nobody is running
+        }
+        errno = err;
+        return -1;
+    }
+
+    // The state and the fds come in one message
+    struct iovec iov = {state, sizeof(*state)};
+    std::vector<char> control(CMSG_SPACE(HANDOFF_MAX_FDS * sizeof(int)));
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+
+    ssize_t length = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+    int err = (length < 0) ? errno : EPROTO;
+
+    // The fds are installed once received, even if the message is wrong
+    std::vector<int> received;
+    bool rights = false;
+    for (struct cmsghdr *cmsg = (length < 0) ? nullptr : CMSG_FIRSTHDR(&msg);
+         cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            size_t offset = received.size();
+            received.resize(offset + count);
+            memcpy(received.data() + offset, CMSG_DATA(cmsg),
+                   count * sizeof(int));
+            rights = true;
+        }
+    }
+
+    bool valid = length == sizeof(*state) &&
+        state->version == HANDOFF_VERSION && rights;
+    if (valid &&
+        (received.size() > maxFds || (msg.msg_flags & MSG_CTRUNC) != 0)) {
+        err = EMSGSIZE;
+        valid = false;
+    }
+    if (!valid) {
+        for (int receivedFd : received) {
+            close(receivedFd);
+        }
+        close(fd);
+        errno = err;
+        return -1;
+    }
+
+    std::copy(received.begin(), received.end(), fds);
+    *sock = fd;
+    return static_cast<int>(received.size());
+}
+
+int handoff_ack(int sock)
+{
+    char ack = 1;
+    ssize_t result = write(sock, &ack, sizeof(ack));
+    close(sock);
+    return (result == sizeof(ack)) ? 0 : -1;
+}
+
+int handoff_give(int listenFd, const struct handoff_state *state,
+                 const int *fds, size_t count, int timeoutMs)
+{
+    if (count == 0 || count > HANDOFF_MAX_FDS) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    struct handoff_state sent = *state;
+    sent.version = HANDOFF_VERSION;
+    struct iovec iov = {&sent, sizeof(sent)};
+    std::vector<char> control(CMSG_SPACE(count * sizeof(int)));
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, count * sizeof(int));
+
+    // The new instance owns the fds once it acknowledged them
+    char ack = 0;
+    struct pollfd pfd = {fd, POLLIN, 0};
+    int result = -1;
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(sent)) {
+        int ready = poll(&pfd, 1, timeoutMs);
+        if (ready == 0) {
+            errno = ETIMEDOUT;
+        } else if (ready > 0 && read(fd, &ack, sizeof(ack)) == sizeof(ack) &&
+                   ack == 1) {
+            result = 0;
+        } else if (ready > 0) {
+            errno = ECONNABORTED;
+        }
+    }
+
+    int err = errno;
+    close(fd);
+    errno = err;
+    return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+/**
+ * @file Hand the open fds of a running simpletap to its replacement
+ *
+ * The running instance listens on a Unix socket. A new instance connects,
+ * receives the TAP queue and serial fds with SCM_RIGHTS and acknowledges
+ * them, the old one exits then. The adapter is never closed: its routes and
+ * addresses stay, forwarding stops for milliseconds only.
+ */
+
+#include <net/if.h>
+
+#include <cstddef>
+#include <cstdint>
+
+enum
+{
+    HANDOFF_MAX_FDS = 64,
+    HANDOFF_OFFLOAD = 0x1,     // TAP opened with IFF_VNET_HDR
+    HANDOFF_PERSIST_SET = 0x2, // TUNSETPERSIST set for the handoff only
+};
+
+/* Sent along with the fds */
+struct handoff_state
+{
+    uint32_t version;
+    uint32_t flags;
+    char adapterName[IF_NAMESIZE];
+};
+
+/**
+ * Listen for the next instance, a stale socket file is replaced
+ * @return The listening socket, or -1 with errno set
+ */
+int handoff_listen(const char *path);
+
+/**
+ * Take over the fds of the instance listening at path
+ * @param sock      Set to the connection, for handoff_ack()
+ * @param state     Set to what the running instance sent
+ * @param fds       Set to the received fds
+ * @param maxFds    Size of fds
+ * @return Number of fds, 0 if no instance is listening, or -1 with errno set
+ */
+int handoff_take(const char *path, int *sock, struct handoff_state *state,
+                 int *fds, size_t maxFds);
+
+/**
+ * Acknowledge the fds from handoff_take() and close the connection, the
+ * old instance stops then. Without it the old instance goes on.
+ */
+int handoff_ack(int sock);
+
+/**
+ * Hand the fds to the instance that connected to listenFd
+ * @param timeoutMs How long to wait for the acknowledgement
+ * @return 0 if the new instance took the fds, -1 with errno set if not
+ */
+int handoff_give(int listenFd, const struct handoff_state *state,
+                 const int *fds, size_t count, int timeoutMs);
@@ -0,0 +1,276 @@
+#include "IoUring.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef SERIAL_TUN_HAVE_IO_URING
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <sys/uio.h>
+#    include <unistd.h>
+
+#    include <vector>
+
+namespace {
+
+/* true if the kernel has the opcodes the prep functions use. Before 5.6
+ * there is no IORING_OP_READ/WRITE, and no IORING_REGISTER_PROBE either. */
+bool opcodesSupported(int fd)
+{
+    constexpr unsigned PROBE_OPS = 256;
+    std::vector<uint64_t> memory(
+        (sizeof(struct io_uring_probe) +
+         PROBE_OPS * sizeof(struct io_uring_probe_op) + sizeof(uint64_t) -
+         1) /
+        sizeof(uint64_t));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto *probe = reinterpret_cast<struct io_uring_probe *>(memory.data());
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe,
+                PROBE_OPS) < 0) {
+        return false;
+    }
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-constant-array-index)
+    for (unsigned op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READ_FIXED,
+                        IORING_OP_WRITE_FIXED, IORING_OP_TIMEOUT}) {
+        if (op > probe->last_op ||
+            (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+            return false;
+        }
+    }
+    // NOLINTEND(cppcoreguidelines-pro-bounds-constant-array-index)
+    return true;
+}
+
+} // namespace
+
+IoUring::IoUring(unsigned entries)
+{
+    struct io_uring_params params = {};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) {
+        return;
+    }
+    if (!opcodesSupported(fd)) {
+        close(fd);
+        errno = ENOSYS;
+        return;
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes +
+        params.cq_entries * sizeof(struct io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        close(fd);
+        return;
+    }
+    if (singleMmap) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            munmap(sqRing, sqRingSize);
+            close(fd);
+            return;
+        }
+    }
+
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void *sqesMap = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqesMap == MAP_FAILED) {
+        if (cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        munmap(sqRing, sqRingSize);
+        close(fd);
+        return;
+    }
+    sqes = static_cast<struct io_uring_sqe *>(sqesMap);
+
+    // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    auto *sq = static_cast<uint8_t *>(sqRing);
+    sqHead = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+    auto *cq = static_cast<uint8_t *>(cqRing);
+    cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+
+    ringFd = fd;
+}
+
+IoUring::~IoUring()
+{
+    if (ringFd < 0) {
+        return;
+    }
+
+    munmap(sqes, sqesSize);
+    if (cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    munmap(sqRing, sqRingSize);
+    close(ringFd);
+}
+
+bool IoUring::registerBuffer(void *base, size_t length)
+{
+    struct iovec iov = {base, length};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, &iov,
+                1) < 0) {
+        return false;
+    }
+
+    registered = static_cast<const uint8_t *>(base);
+    registeredLength = length;
+    return true;
+}
+
+bool IoUring::fixed(const void *buf, size_t length) const
+{
+    const auto *data = static_cast<const uint8_t *>(buf);
+    return registered != nullptr && data >= registered &&
+        static_cast<size_t>(data - registered) + length <= registeredLength;
+}
+
+struct io_uring_sqe *IoUring::nextSqe()
+{
+    // We are the only producer, the kernel moves the head. NOTE: without
+    // SQPOLL the kernel reads the queue in submit() only, the entry may be
+    // published before it is filled in.
+    unsigned tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+        return nullptr;
+    }
+
+    unsigned index = tail & sqMask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    toSubmit++;
+    return sqe;
+}
+
+bool IoUring::prepRead(int fd, void *buf, size_t length, uint64_t userData)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (sqe == nullptr) {
+        return false;
+    }
+
+    sqe->opcode = fixed(buf, length) ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(buf);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = static_cast<uint64_t>(-1); // current position, for streams
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::prepWrite(int fd, const void *buf, size_t length,
+                        uint64_t userData, bool link)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (sqe == nullptr) {
+        return false;
+    }
+
+    sqe->opcode = fixed(buf, length) ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(buf);
+    sqe->len = static_cast<uint32_t>(length);
+    sqe->off = static_cast<uint64_t>(-1);
+    sqe->flags = link ? IOSQE_IO_LINK : 0;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::prepTimeout(unsigned timeoutMs, uint64_t userData)
+{
+    struct io_uring_sqe *sqe = nextSqe();
+    if (sqe == nullptr) {
+        return false;
+    }
+
+    // NOTE: the kernel reads the timespec at submission
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_nsec = (timeoutMs % 1000) * 1000000L;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uintptr_t>(&timeout);
+    sqe->len = 1;
+    sqe->user_data = userData;
+    return true;
+}
+
+int IoUring::submit(unsigned waitFor)
+{
+    unsigned flags = (waitFor > 0) ? IORING_ENTER_GETEVENTS : 0;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int submitted = static_cast<int>(syscall(__NR_io_uring_enter, ringFd,
+                                             toSubmit, waitFor, flags,
+                                             nullptr, 0));
+    if (submitted < 0) {
+        return -1;
+    }
+
+    toSubmit -= static_cast<unsigned>(submitted);
+    return submitted;
+}
+
+#else
+
+IoUring::IoUring(unsigned /*entries*/) {}
+IoUring::~IoUring() = default;
+
+bool IoUring::registerBuffer(void * /*base*/, size_t /*length*/)
+{
+    return false;
+}
+
+bool IoUring::prepRead(int /*fd*/, void * /*buf*/, size_t /*length*/,
+                       uint64_t /*userData*/)
+{
+    return false;
+}
+
+bool IoUring::prepWrite(int /*fd*/, const void * /*buf*/, size_t /*length*/,
+                        uint64_t /*userData*/, bool /*link*/)
+{
+    return false;
+}
+
+bool IoUring::prepTimeout(unsigned /*timeoutMs*/, uint64_t /*userData*/)
+{
+    return false;
+}
+
+int IoUring::submit(unsigned /*waitFor*/)
+{
+    errno = ENOSYS;
+    return -1;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#pragma once
+
+/**
+ * @file Minimal io_uring wrapper on the raw syscalls
+ *
+ * Only what the forwarding loops need: reads and writes on fds, optionally
+ * on one registered buffer, linked writes, a timeout, batched submission and
+ * completions reaped from the shared ring without a syscall.
+ */
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#        define SERIAL_TUN_HAVE_IO_URING 1
+#        include <linux/io_uring.h>
+#    endif
+#endif
+
+class IoUring
+{
+public:
+    /**
+     * Set up a ring, check valid() before use
+     * @param entries   Submission queue size, a power of 2
+     */
+    explicit IoUring(unsigned entries);
+    ~IoUring();
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+    IoUring(IoUring &&) = delete;
+    IoUring &operator=(IoUring &&) = delete;
+
+    /* false if the kernel has no io_uring (or it is not permitted), or no
+     * IORING_OP_READ/WRITE (before 5.6) */
+    bool valid() const { return ringFd >= 0; }
+
+    /**
+     * Register one buffer with the kernel, reads and writes inside it then
+     * use the fixed buffer opcodes and skip the page pinning per request
+     * @return false if registration failed, the ring still works
+     */
+    bool registerBuffer(void *base, size_t length);
+
+    /**
+     * Queue a read, it is sent to the kernel by the next submit()
+     * @return false if the submission queue is full
+     */
+    bool prepRead(int fd, void *buf, size_t length, uint64_t userData);
+
+    /**
+     * Queue a write
+     * @param link      The next queued request starts after this one
+     *                  completed, to keep writes to one fd in order
+     * @return false if the submission queue is full
+     */
+    bool prepWrite(int fd, const void *buf, size_t length, uint64_t userData,
+                   bool link = false);
+
+    /**
+     * Queue a timeout, it completes with -ETIME after timeoutMs
+     * @return false if the submission queue is full
+     */
+    bool prepTimeout(unsigned timeoutMs, uint64_t userData);
+
+    /**
+     * Submit the queued requests and wait for completions
+     * @param waitFor   Number of completions to wait for, 0 to return at once
+     * @return Number of requests submitted, or -1 with errno set
+     */
+    int submit(unsigned waitFor = 0);
+
+    /**
+     * Hand every completion to onCompletion(userData, result), no syscall.
+     * result is what the syscall would return, or -errno.
+     * @return Number of completions
+     */
+    template <typename Callback>
+    unsigned reap(Callback &&onCompletion)
+    {
+        unsigned count = 0;
+#ifdef SERIAL_TUN_HAVE_IO_URING
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            const struct io_uring_cqe &cqe = cqes[head & cqMask];
+            onCompletion(cqe.user_data, cqe.res);
+            // cqe points into the ring, the entry is released after the
+            // callback is done with it
+            __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+            count++;
+        }
+#else
+        (void)onCompletion;
+#endif
+        return count;
+    }
+
+private:
+#ifdef SERIAL_TUN_HAVE_IO_URING
+    struct io_uring_sqe *nextSqe();
+    bool fixed(const void *buf, size_t length) const;
+
+    void *sqRing = nullptr;
+    size_t sqRingSize = 0;
+    void *cqRing = nullptr;
+    size_t cqRingSize = 0;
+    struct io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned *sqArray = nullptr;
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    struct io_uring_cqe *cqes = nullptr;
+
+    struct __kernel_timespec timeout = {};
+    const uint8_t *registered = nullptr;
+    size_t registeredLength = 0;
+#endif
+    unsigned toSubmit = 0;
+    int ringFd = -1;
+};
@@ -0,0 +1,193 @@
+#include "PacketPool.h"
+
+#include "tun-driver.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifdef __linux__
+#    include <sys/mman.h>
+#endif
+
+namespace {
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+size_t roundUp(size_t bytes, size_t unit)
+{
+    return (bytes + unit - 1) / unit * unit;
+}
+
+} // namespace
+
+size_t PacketRef::headerSize()
+{
+    return roundUp(sizeof(Header), PacketPool::CACHE_LINE);
+}
+
+PacketRef::PacketRef(const PacketRef &other) noexcept : buffer(other.buffer)
+{
+    if (buffer != nullptr) {
+        buffer->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+PacketRef::PacketRef(PacketRef &&other) noexcept : buffer(other.buffer)
+{
+    other.buffer = nullptr;
+}
+
+PacketRef &PacketRef::operator=(const PacketRef &other) noexcept
+{
+    if (this != &other) {
+        PacketRef copy(other);
+        reset();
+        buffer = copy.buffer;
+        copy.buffer = nullptr;
+    }
+    return *this;
+}
+
+PacketRef &PacketRef::operator=(PacketRef &&other) noexcept
+{
+    if (this != &other) {
+        reset();
+        buffer = other.buffer;
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+char *PacketRef::data() const
+{
+    return reinterpret_cast<char *>(buffer) + headerSize(); // NOLINT
+}
+
+size_t PacketRef::capacity() const { return buffer->pool->capacity(); }
+
+size_t PacketRef::length() const { return buffer->length; }
+
+void PacketRef::setLength(size_t length)
+{
+    Expects(length <= capacity());
+    buffer->length = static_cast<uint32_t>(length);
+}
+
+uint32_t PacketRef::useCount() const
+{
+    return (buffer == nullptr) ? 0
+                               : buffer->refs.load(std::memory_order_relaxed);
+}
+
+void PacketRef::reset() noexcept
+{
+    // The last one makes the writes of the others visible to the pool
+    if (buffer != nullptr &&
+        buffer->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        buffer->pool->release(buffer);
+    }
+    buffer = nullptr;
+}
+
+void *PacketRef::release() noexcept
+{
+    Header *header = buffer;
+    buffer = nullptr;
+    return header;
+}
+
+PacketRef PacketRef::adopt(void *released) noexcept
+{
+    return PacketRef(static_cast<Header *>(released));
+}
+
+PacketPool::PacketPool(size_t _count, size_t capacity, bool hugePages)
+    : count(_count), bufferCapacity(capacity),
+      stride(roundUp(PacketRef::headerSize() + capacity, CACHE_LINE))
+{
+    void *mapped = nullptr;
+#ifdef __linux__
+    // Populated at once, no page faults on the packet path
+    if (hugePages) {
+        mappedLength = roundUp(count * stride, HUGE_PAGE);
+        mapped = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE,
+                      -1, 0);
+        hugeTlb = mapped != MAP_FAILED;
+        if (!hugeTlb) {
+            SPDLOG_INFO("No huge pages for the packet pool ({}), using"
+                        " transparent huge pages",
+                        strerror(errno));
+        }
+    }
+    if (!hugeTlb) {
+        mappedLength = count * stride;
+        mapped = mmap(nullptr, mappedLength, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (mapped != MAP_FAILED && hugePages) {
+            (void)madvise(mapped, mappedLength, MADV_HUGEPAGE);
+        }
+    }
+    if (mapped == MAP_FAILED) {
+        SPDLOG_ERROR("mmap() error({}) {}", errno, strerror(errno));
+        return;
+    }
+#else
+    (void)hugePages;
+    mappedLength = count * stride;
+    mapped = ::operator new(mappedLength, std::align_val_t(CACHE_LINE),
+                            std::nothrow);
+    if (mapped == nullptr) {
+        return;
+    }
+#endif
+    memory = static_cast<char *>(mapped);
+
+    freeList.reserve(count);
+    for (size_t i = count; i > 0; i--) {
+        freeList.push_back(new (memory + (i - 1) * stride)
+                               PacketRef::Header{{0}, 0, this});
+    }
+}
+
+PacketPool::~PacketPool()
+{
+    if (memory == nullptr) {
+        return;
+    }
+#ifdef __linux__
+    munmap(memory, mappedLength);
+#else
+    ::operator delete(memory, std::align_val_t(CACHE_LINE));
+#endif
+}
+
+PacketRef PacketPool::allocate()
+{
+    PacketRef::Header *header = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(freeMutex);
+        if (freeList.empty()) {
+            return {};
+        }
+        header = freeList.back();
+        freeList.pop_back();
+    }
+    header->refs.store(1, std::memory_order_relaxed);
+    header->length = 0;
+    return PacketRef(header);
+}
+
+size_t PacketPool::available() const
+{
+    std::lock_guard<std::mutex> lock(freeMutex);
+    return freeList.size();
+}
+
+void PacketPool::release(PacketRef::Header *header) noexcept
+{
+    std::lock_guard<std::mutex> lock(freeMutex);
+    freeList.push_back(header);
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+/**
+ * @file Fixed pool of refcounted packet buffers
+ *
+ * All buffers are allocated up front, cache line aligned and touched once,
+ * optionally in huge pages. A PacketRef counts the references to its
+ * buffer, the last one returns it to the pool. Packets are handed between
+ * the TAP reader, the extensions and the serial writer as PacketRef, so a
+ * packet is written into memory once and the pool bounds the packets in
+ * flight.
+ */
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+class PacketPool;
+
+/* A reference to a pool buffer, empty if the pool had none left */
+class PacketRef
+{
+public:
+    PacketRef() = default;
+    PacketRef(const PacketRef &other) noexcept;
+    PacketRef(PacketRef &&other) noexcept;
+    PacketRef &operator=(const PacketRef &other) noexcept;
+    PacketRef &operator=(PacketRef &&other) noexcept;
+    ~PacketRef() { reset(); }
+
+    explicit operator bool() const { return buffer != nullptr; }
+
+    char *data() const;
+    size_t capacity() const;
+    size_t length() const;
+    void setLength(size_t length);
+
+    /* References to the buffer, this one included */
+    uint32_t useCount() const;
+
+    /* Drop the reference, the last one returns the buffer */
+    void reset() noexcept;
+
+    /**
+     * Give up the reference without dropping it, to pass it on as a plain
+     * pointer (through an SpscRing for example)
+     */
+    void *release() noexcept;
+
+    /* Take over a reference given up with release() */
+    static PacketRef adopt(void *released) noexcept;
+
+private:
+    friend class PacketPool;
+
+    // In front of every buffer
+    struct Header
+    {
+        std::atomic<uint32_t> refs;
+        uint32_t length;
+        PacketPool *pool;
+    };
+
+    explicit PacketRef(Header *header) noexcept : buffer(header) {}
+
+    // Header rounded up to a cache line, the data follows
+    static size_t headerSize();
+
+    Header *buffer = nullptr;
+};
+
+class PacketPool
+{
+public:
+    /* Size of a cache line, buffers start on one */
+    static constexpr size_t CACHE_LINE = 64;
+
+    /**
+     * @param count         Buffers in the pool
+     * @param capacity      Bytes per buffer
+     * @param hugePages     Try MAP_HUGETLB first, then transparent huge
+     *                      pages
+     */
+    PacketPool(size_t count, size_t capacity, bool hugePages = false);
+    ~PacketPool();
+
+    PacketPool(const PacketPool &) = delete;
+    PacketPool &operator=(const PacketPool &) = delete;
+    PacketPool(PacketPool &&) = delete;
+    PacketPool &operator=(PacketPool &&) = delete;
+
+    /* false if the memory could not be mapped */
+    bool valid() const { return memory != nullptr; }
+
+    /**
+     * A buffer with a length of 0
+     * @return empty if all buffers are in use
+     */
+    PacketRef allocate();
+
+    size_t size() const { return count; }
+    size_t capacity() const { return bufferCapacity; }
+
+    /* Buffers not in use, a snapshot */
+    size_t available() const;
+
+    /* true if the buffers are in MAP_HUGETLB pages */
+    bool hugePages() const { return hugeTlb; }
+
+private:
+    friend class PacketRef;
+
+    void release(PacketRef::Header *header) noexcept;
+
+    const size_t count;
+    const size_t bufferCapacity;
+    size_t stride = 0;
+    size_t mappedLength = 0;
+    bool hugeTlb = false;
+    char *memory = nullptr;
+
+    // NOTE: taken once per packet and direction, never held for long
+    mutable std::mutex freeMutex;
+    std::vector<PacketRef::Header *> freeList;
+};
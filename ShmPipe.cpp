@@ -0,0 +1,298 @@
+#include "ShmPipe.h"
+
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include <cstring>
+
+#ifdef __linux__
+#    include <sys/mman.h>
+
+namespace {
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+constexpr uint32_t SHM_MAGIC = 0x53484d50; // "SHMP"
+constexpr uint32_t SHM_VERSION = 1;
+constexpr int SHM_RINGS = 4; // up and down for OUTER and INNER
+// Limits for what the header says, it comes from the other process
+constexpr uint32_t SHM_MAX_SLOTS = 4096;
+constexpr uint32_t SHM_MAX_PACKET = 1U << 20U;
+
+/* At the start of the memory, the rings follow */
+struct ShmHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t packetLength;
+};
+
+size_t headerSize()
+{
+    return (sizeof(ShmHeader) + SpscRing::CACHE_LINE - 1) &
+        ~(SpscRing::CACHE_LINE - 1);
+}
+
+size_t memorySize(size_t slotCount, size_t packetLength)
+{
+    return headerSize() +
+        SHM_RINGS * SpscRing::memorySize(slotCount, packetLength);
+}
+
+bool socketAddress(const char *path, struct sockaddr_un *addr)
+{
+    *addr = {};
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+    return true;
+}
+
+/* Accept one connection, io_cancel() ends the wait */
+int acceptPeer(const char *path)
+{
+    struct sockaddr_un addr;
+    if (!socketAddress(path, &addr)) {
+        return -1;
+    }
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        return -1;
+    }
+    unlink(path);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr),
+             sizeof(addr)) < 0 ||
+        listen(listenFd, 1) < 0) {
+        int error = errno;
+        close(listenFd);
+        errno = error;
+        return -1;
+    }
+
+    int peer = -1;
+    while (peer < 0 && io_is_enabled()) {
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) > 0) {
+            peer = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        }
+    }
+    int error = io_is_enabled() ? errno : ECANCELED;
+    close(listenFd);
+    unlink(path);
+    errno = error;
+    return peer;
+}
+
+} // namespace
+
+ShmPipe::ShmPipe(bool host, int socket, void *_memory, size_t _memoryLength,
+                 size_t slotCount, size_t packetLength)
+    : sock(socket), memory(_memory), memoryLength(_memoryLength),
+      maxPacketLength(packetLength)
+{
+    char *base = static_cast<char *>(memory) + headerSize();
+    size_t ringSize = SpscRing::memorySize(slotCount, packetLength);
+    for (int i = 0; i < SHM_RINGS; i++) {
+        rings.push_back(std::make_unique<SpscRing>(base, slotCount,
+                                                   packetLength, host));
+        base += ringSize;
+    }
+
+    // rings[channel] goes up from the host, rings[2 + channel] down
+    if (host) {
+        toRing = {{rings[OUTER].get(), rings[INNER].get()}};
+        fromRing = {{rings[2 + OUTER].get(), rings[2 + INNER].get()}};
+    } else {
+        toRing = {{rings[2 + OUTER].get(), rings[2 + INNER].get()}};
+        fromRing = {{rings[OUTER].get(), rings[INNER].get()}};
+    }
+}
+
+ShmPipe::~ShmPipe()
+{
+    rings.clear();
+    munmap(memory, memoryLength);
+    if (sock >= 0) {
+        close(sock);
+    }
+}
+
+std::unique_ptr<ShmPipe> ShmPipe::serve(const char *path, size_t packetLength,
+                                        size_t slotCount)
+{
+    size_t length = memorySize(slotCount, packetLength);
+    int memFd = memfd_create("simpletap-extension",
+                             MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0) {
+        return nullptr;
+    }
+
+    // The peer must not shrink it under our feet (SIGBUS)
+    void *memory = MAP_FAILED;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (ftruncate(memFd, static_cast<off_t>(length)) < 0 ||
+        fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) <
+            0 ||
+        (memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED,
+                       memFd, 0)) == MAP_FAILED) {
+        int error = errno;
+        close(memFd);
+        errno = error;
+        return nullptr;
+    }
+
+    auto *header = static_cast<ShmHeader *>(memory);
+    *header = {SHM_MAGIC, SHM_VERSION, static_cast<uint32_t>(slotCount),
+               static_cast<uint32_t>(packetLength)};
+    std::unique_ptr<ShmPipe> pipe(
+        new ShmPipe(true, -1, memory, length, slotCount, packetLength));
+
+    int peer = acceptPeer(path);
+    if (peer < 0) {
+        int error = errno;
+        close(memFd);
+        errno = error;
+        return nullptr;
+    }
+    pipe->sock = peer;
+
+    // One byte with the memfd
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    std::array<char, CMSG_SPACE(sizeof(int))> control{};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memFd, sizeof(int));
+    ssize_t sent = sendmsg(peer, &msg, MSG_NOSIGNAL);
+    int error = errno;
+    close(memFd);
+    if (sent != 1) {
+        errno = error;
+        return nullptr;
+    }
+    return pipe;
+}
+
+std::unique_ptr<ShmPipe> ShmPipe::attach(const char *path)
+{
+    struct sockaddr_un addr;
+    if (!socketAddress(path, &addr)) {
+        return nullptr;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        return nullptr;
+    }
+
+    char byte = 0;
+    struct iovec iov = {&byte, 1};
+    std::array<char, CMSG_SPACE(sizeof(int))> control{};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    int memFd = -1;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    if (connect(sock, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) == 0 &&
+        recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == 1) {
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != nullptr && cmsg->cmsg_level == SOL_SOCKET &&
+            cmsg->cmsg_type == SCM_RIGHTS) {
+            memcpy(&memFd, CMSG_DATA(cmsg), sizeof(int));
+        } else {
+            errno = EPROTO;
+        }
+    }
+    if (memFd < 0) {
+        int error = errno;
+        close(sock);
+        errno = error;
+        return nullptr;
+    }
+
+    // Sealed, the size stays what the header says
+    struct stat st = {};
+    void *memory = MAP_FAILED;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int seals = fcntl(memFd, F_GET_SEALS);
+    if (fstat(memFd, &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(ShmHeader) &&
+        (seals & F_SEAL_SHRINK) != 0) {
+        memory = mmap(nullptr, static_cast<size_t>(st.st_size),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    } else {
+        errno = EPROTO;
+    }
+    int error = errno;
+    close(memFd);
+    if (memory == MAP_FAILED) {
+        close(sock);
+        errno = error;
+        return nullptr;
+    }
+
+    const auto *header = static_cast<const ShmHeader *>(memory);
+    size_t length = static_cast<size_t>(st.st_size);
+    if (header->magic != SHM_MAGIC || header->version != SHM_VERSION ||
+        header->slotCount == 0 || header->slotCount > SHM_MAX_SLOTS ||
+        header->packetLength > SHM_MAX_PACKET ||
+        memorySize(header->slotCount, header->packetLength) > length) {
+        munmap(memory, length);
+        close(sock);
+        errno = EPROTO;
+        return nullptr;
+    }
+    return std::unique_ptr<ShmPipe>(new ShmPipe(
+        false, sock, memory, length, header->slotCount, header->packetLength));
+}
+
+bool ShmPipe::connected() const noexcept
+{
+    // The other process closed the socket, or died
+    char byte = 0;
+    return recv(sock, &byte, 1, MSG_PEEK | MSG_DONTWAIT) != 0;
+}
+
+#else
+
+ShmPipe::ShmPipe(bool /*host*/, int socket, void *_memory,
+                 size_t _memoryLength, size_t /*slotCount*/,
+                 size_t packetLength)
+    : sock(socket), memory(_memory), memoryLength(_memoryLength),
+      maxPacketLength(packetLength)
+{}
+
+ShmPipe::~ShmPipe() = default;
+
+std::unique_ptr<ShmPipe> ShmPipe::serve(const char * /*path*/,
+                                        size_t /*packetLength*/,
+                                        size_t /*slotCount*/)
+{
+    errno = ENOSYS;
+    return nullptr;
+}
+
+std::unique_ptr<ShmPipe> ShmPipe::attach(const char * /*path*/)
+{
+    errno = ENOSYS;
+    return nullptr;
+}
+
+bool ShmPipe::connected() const noexcept { return false; }
+
+#endif
@@ -0,0 +1,56 @@
+#pragma once
+
+/**
+ * @file ExtensionPoint shared with another process
+ *
+ * The RED processing may run in a process of its own. The host (simpletap)
+ * creates a memfd with four SpscRing, two per channel, and hands it to the
+ * peer over a Unix socket. The host's write(channel) is the peer's
+ * read(channel), the peer's write(channel) is the host's read(channel).
+ * A peer that copies OUTER to INNER and back is what Pipe does.
+ *
+ * Packets are copied into the shared slots, a side makes a syscall only
+ * to sleep on or wake up a futex. The socket stays open to notice when the
+ * other process is gone.
+ */
+
+#include "ExtensionPoint.h"
+
+#include <memory>
+
+// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
+class ShmPipe : public RingPipe
+{
+public:
+    /**
+     * Create the shared rings, wait for the peer to connect to path and
+     * hand them over
+     * @return nullptr with errno set on error, ECANCELED after io_cancel()
+     */
+    static std::unique_ptr<ShmPipe> serve(const char *path,
+                                          size_t packetLength,
+                                          size_t slotCount = RING_SLOTS);
+
+    /**
+     * Map the shared rings of the host listening at path
+     * @return nullptr with errno set on error
+     */
+    static std::unique_ptr<ShmPipe> attach(const char *path);
+
+    ~ShmPipe() override;
+
+    /* Longest packet, set by the host */
+    size_t packetLength() const { return maxPacketLength; }
+
+protected:
+    bool connected() const noexcept override;
+
+private:
+    ShmPipe(bool host, int socket, void *memory, size_t memoryLength,
+            size_t slotCount, size_t packetLength);
+
+    int sock;
+    void *memory;
+    size_t memoryLength;
+    size_t maxPacketLength;
+};
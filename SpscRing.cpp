@@ -0,0 +1,187 @@
+#include "SpscRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+
+#ifdef __linux__
+#    include <linux/futex.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+static uint32_t roundUpPow2(size_t count)
+{
+    uint32_t size = 1;
+    while (size < count) {
+        size <<= 1U;
+    }
+    return size;
+}
+
+static size_t roundUpCacheLine(size_t bytes)
+{
+    return (bytes + SpscRing::CACHE_LINE - 1) & ~(SpscRing::CACHE_LINE - 1);
+}
+
+size_t SpscRing::memorySize(size_t slotCount, size_t slotSize)
+{
+    size_t count = roundUpPow2(slotCount);
+    return roundUpCacheLine(sizeof(Control)) +
+        roundUpCacheLine(count * sizeof(uint32_t)) +
+        roundUpCacheLine(count * slotSize);
+}
+
+SpscRing::SpscRing(size_t slotCount, size_t _slotSize)
+    : mask(roundUpPow2(slotCount) - 1), slotSize(_slotSize), shared(false),
+      owned(memorySize(slotCount, _slotSize) + CACHE_LINE)
+{
+    // NOTE: std::vector does not align to a cache line
+    void *memory = owned.data();
+    size_t space = owned.size();
+    setUp(std::align(CACHE_LINE, space - CACHE_LINE, memory, space), true);
+}
+
+SpscRing::SpscRing(void *memory, size_t slotCount, size_t _slotSize,
+                   bool initialize)
+    : mask(roundUpPow2(slotCount) - 1), slotSize(_slotSize), shared(true)
+{
+    setUp(memory, initialize);
+}
+
+void SpscRing::setUp(void *memory, bool initialize)
+{
+    char *base = static_cast<char *>(memory);
+    if (initialize) {
+        control = new (base) Control{{0}, {0}, {0}, {0}};
+    } else {
+        control = static_cast<Control *>(memory);
+    }
+    base += roundUpCacheLine(sizeof(Control));
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+    lengths = reinterpret_cast<uint32_t *>(base);
+    base += roundUpCacheLine((mask + 1) * sizeof(uint32_t));
+    slots = base;
+
+    tailCache = control->tail.load(std::memory_order_acquire);
+    headCache = control->head.load(std::memory_order_acquire);
+}
+
+ssize_t SpscRing::push(const void *buf, size_t count, int timeoutMs)
+{
+    if (count > slotSize) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    const uint32_t slot = control->tail.load(std::memory_order_relaxed);
+    while (slot - headCache > mask) {
+        headCache = control->head.load(std::memory_order_acquire);
+        if (slot - headCache <= mask) {
+            break;
+        }
+        if (!wait(control->head, headCache, control->producerWaiting,
+                  timeoutMs)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    const size_t index = slot & mask;
+    memcpy(slots + index * slotSize, buf, count);
+    lengths[index] = static_cast<uint32_t>(count);
+    control->tail.store(slot + 1, std::memory_order_release);
+    wake(control->tail, control->consumerWaiting);
+    return static_cast<ssize_t>(count);
+}
+
+ssize_t SpscRing::pop(void *buf, size_t count, int timeoutMs)
+{
+    const uint32_t slot = control->head.load(std::memory_order_relaxed);
+    while (slot == tailCache) {
+        tailCache = control->tail.load(std::memory_order_acquire);
+        if (slot != tailCache) {
+            break;
+        }
+        if (!wait(control->tail, tailCache, control->consumerWaiting,
+                  timeoutMs)) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    // NOTE: the length is written by the other side, maybe another process
+    const size_t index = slot & mask;
+    size_t length = std::min({static_cast<size_t>(lengths[index]), count,
+                              slotSize});
+    memcpy(buf, slots + index * slotSize, length);
+    control->head.store(slot + 1, std::memory_order_release);
+    wake(control->head, control->producerWaiting);
+    return static_cast<ssize_t>(length);
+}
+
+size_t SpscRing::size() const
+{
+    return control->tail.load(std::memory_order_acquire) -
+        control->head.load(std::memory_order_acquire);
+}
+
+bool SpscRing::wait(std::atomic<uint32_t> &index, uint32_t seen,
+                    std::atomic<uint32_t> &waiting, int timeoutMs)
+{
+    if (timeoutMs == 0) {
+        return false;
+    }
+
+    // Marked first: the other side either sees the mark after it moved the
+    // index, or the futex sees the moved index and does not sleep
+    waiting.store(1, std::memory_order_seq_cst);
+    if (index.load(std::memory_order_seq_cst) != seen) {
+        waiting.store(0, std::memory_order_relaxed);
+        return true;
+    }
+    waitCount.fetch_add(1, std::memory_order_relaxed);
+
+#ifdef __linux__
+    struct timespec timeout = {timeoutMs / 1000, (timeoutMs % 1000) * 1000000};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    long result = syscall(SYS_futex, reinterpret_cast<uint32_t *>(&index),
+                          shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, seen,
+                          (timeoutMs < 0) ? nullptr : &timeout, nullptr, 0);
+    bool timedOut = result < 0 && errno == ETIMEDOUT;
+#else
+    // NOTE: no futex, poll the index
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(timeoutMs);
+    while (index.load(std::memory_order_acquire) == seen &&
+           (timeoutMs < 0 || std::chrono::steady_clock::now() < deadline)) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    bool timedOut = index.load(std::memory_order_acquire) == seen;
+#endif
+
+    waiting.store(0, std::memory_order_relaxed);
+    return !timedOut;
+}
+
+void SpscRing::wake(std::atomic<uint32_t> &index,
+                    std::atomic<uint32_t> &waiting)
+{
+    // Pairs with the store of the mark in wait()
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting.load(std::memory_order_relaxed) == 0) {
+        return;
+    }
+#ifdef __linux__
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    (void)syscall(SYS_futex, reinterpret_cast<uint32_t *>(&index),
+                  shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, 1, nullptr,
+                  nullptr, 0);
+#else
+    (void)index;
+#endif
+}
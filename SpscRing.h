@@ -0,0 +1,108 @@
+#pragma once
+
+/**
+ * @file Lock-free single producer, single consumer ring of packet slots
+ *
+ * Every slot holds one packet of up to slotSize bytes. The producer owns
+ * the tail and the consumer the head, each on its own cache line with a
+ * private copy of the other index, so the shared line is only read when
+ * the copy says the ring is full or empty. A side sleeps on a futex only
+ * then, the other one wakes it up if it is marked as waiting.
+ *
+ * The ring either owns its memory, or lives in memory shared with another
+ * process (see memorySize()), one side each.
+ */
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SpscRing
+{
+public:
+    /* Size of a cache line, the indexes must not share one */
+    static constexpr size_t CACHE_LINE = 64;
+
+    /**
+     * @param slotCount     Packets the ring holds, rounded up to a power
+     *                      of two
+     * @param slotSize      Longest packet
+     */
+    SpscRing(size_t slotCount, size_t slotSize);
+
+    /**
+     * A ring in shared memory of memorySize() bytes, aligned to CACHE_LINE
+     * @param initialize    true for the process that creates the memory
+     */
+    SpscRing(void *memory, size_t slotCount, size_t slotSize,
+             bool initialize);
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+    SpscRing(SpscRing &&) = delete;
+    SpscRing &operator=(SpscRing &&) = delete;
+
+    /* Bytes of shared memory a ring needs, a multiple of CACHE_LINE */
+    static size_t memorySize(size_t slotCount, size_t slotSize);
+
+    /**
+     * Producer only: copy a packet into the next free slot
+     * @param timeoutMs     How long to wait while the ring is full, 0 not
+     *                      at all and -1 without limit
+     * @return count, or -1 with errno set (EMSGSIZE, ETIMEDOUT)
+     */
+    ssize_t push(const void *buf, size_t count, int timeoutMs);
+
+    /**
+     * Consumer only: copy the oldest packet to buf, a longer one is
+     * truncated as a datagram would be
+     * @param timeoutMs     How long to wait while the ring is empty, 0 not
+     *                      at all and -1 without limit
+     * @return Bytes copied, or -1 with errno set (ETIMEDOUT)
+     */
+    ssize_t pop(void *buf, size_t count, int timeoutMs);
+
+    /* Packets in the ring, a snapshot */
+    size_t size() const;
+
+    /* Times this side slept on the futex, to make the cost visible */
+    size_t waits() const { return waitCount.load(std::memory_order_relaxed); }
+
+private:
+    // The part both sides write, at the start of the memory
+    struct Control
+    {
+        // Consumer side
+        alignas(CACHE_LINE) std::atomic<uint32_t> head;
+        std::atomic<uint32_t> consumerWaiting;
+
+        // Producer side
+        alignas(CACHE_LINE) std::atomic<uint32_t> tail;
+        std::atomic<uint32_t> producerWaiting;
+    };
+
+    void setUp(void *memory, bool initialize);
+
+    // Sleep while index is still at seen, see the file comment
+    bool wait(std::atomic<uint32_t> &index, uint32_t seen,
+              std::atomic<uint32_t> &waiting, int timeoutMs);
+    void wake(std::atomic<uint32_t> &index, std::atomic<uint32_t> &waiting);
+
+    const uint32_t mask;
+    const size_t slotSize;
+    const bool shared;
+    std::vector<char> owned; // the memory, if not shared
+
+    Control *control = nullptr;
+    uint32_t *lengths = nullptr;
+    char *slots = nullptr;
+
+    // Private copies of the other side's index
+    uint32_t tailCache = 0;
+    uint32_t headCache = 0;
+
+    std::atomic<size_t> waitCount{0};
+};
@@ -0,0 +1,278 @@
+/**
+ * @file Microbenchmark of the serial framing codecs
+ *
+ * Reports ns/frame and MB/s of payload for encode and decode, per codec
+ * variant, frame size and escape density. The output is CSV (default) or
+ * JSON, one record per measurement, to compare releases.
+ * A new codec variant only needs an entry in the variants table.
+ */
+
+#include "cobs.h"
+#include "slip.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+typedef enum slip_result (*codecFn_t)(const inBuffer_t &input,
+                                      size_t inputLength, Buffer_t &output,
+                                      size_t *outputSize);
+
+/* One codec under test */
+struct Variant
+{
+    const char *name;
+    codecFn_t encode;
+    codecFn_t decode;
+    // Bytes the framing has to escape, the payload is made of these
+    // at the selected density
+    std::vector<uint8_t> special;
+    // Skipped on a CPU without it, it would run a lower one
+    enum slip_isa isa = SLIP_ISA_SCALAR;
+};
+
+template <enum slip_isa Isa>
+enum slip_result slipEncodeIsa(const inBuffer_t &frame, size_t frameLength,
+                               Buffer_t &output, size_t *outputSize)
+{
+    return slip_encode_isa(Isa, frame, frameLength, output, outputSize);
+}
+
+template <enum slip_isa Isa>
+enum slip_result slipDecodeIsa(const inBuffer_t &encodedFrame,
+                               size_t frameLength, Buffer_t &output,
+                               size_t *outputSize)
+{
+    return slip_decode_isa(Isa, encodedFrame, frameLength, output,
+                           outputSize);
+}
+
+template <typename Codec>
+enum slip_result codecEncode(const inBuffer_t &frame, size_t frameLength,
+                             Buffer_t &output, size_t *outputSize)
+{
+    return Codec::encode(slip_cpu_isa(), frame, frameLength, output,
+                         outputSize);
+}
+
+template <typename Codec>
+enum slip_result codecDecode(const inBuffer_t &encodedFrame,
+                             size_t frameLength, Buffer_t &output,
+                             size_t *outputSize)
+{
+    return Codec::decode(slip_cpu_isa(), encodedFrame, frameLength, output,
+                         outputSize);
+}
+
+const std::vector<uint8_t> slipSpecial = {SLIP_END, SLIP_ESC};
+
+// With the default ACCM all control characters are escaped
+std::vector<uint8_t> hdlcSpecial()
+{
+    std::vector<uint8_t> special = {PppFraming::END, PppFraming::ESC};
+    for (uint8_t c = 0; c < 0x20; c++) {
+        special.push_back(c);
+    }
+    return special;
+}
+
+// NOTE: add new codecs here, everything else is generic
+const Variant variants[] = {
+    {"slip", slip_encode, slip_decode, slipSpecial},
+    {"slip_scalar", slipEncodeIsa<SLIP_ISA_SCALAR>,
+     slipDecodeIsa<SLIP_ISA_SCALAR>, slipSpecial},
+    {"slip_sse2", slipEncodeIsa<SLIP_ISA_SSE2>, slipDecodeIsa<SLIP_ISA_SSE2>,
+     slipSpecial, SLIP_ISA_SSE2},
+    {"slip_avx2", slipEncodeIsa<SLIP_ISA_AVX2>, slipDecodeIsa<SLIP_ISA_AVX2>,
+     slipSpecial, SLIP_ISA_AVX2},
+    {"slip_crc", slip_encode_crc, slip_decode_crc, slipSpecial},
+    {"hdlc", codecEncode<FrameCodec<PppFraming>>,
+     codecDecode<FrameCodec<PppFraming>>, hdlcSpecial()},
+    {"cobs", cobs_encode, cobs_decode, {COBS_END}},
+};
+
+/* Escape density of the payload */
+struct Density
+{
+    const char *name;
+    int percent; // share of special bytes, -1 for uniformly random bytes
+};
+
+const Density densities[] = {
+    {"0%", 0},
+    {"1%", 1},
+    {"random", -1},
+    {"100%", 100},
+};
+
+const size_t frameSizes[] = {64, 128, 256, 512, 1024, 1500,
+                             SLIP_IN_FRAME_LENGTH};
+
+struct Result
+{
+    double nsPerFrame;
+    double megabytesPerSecond;
+};
+
+Buffer_t makeFrame(size_t length, const Density &density,
+                   const std::vector<uint8_t> &special, std::mt19937 &rng)
+{
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<unsigned> byte(0, UINT8_MAX);
+    std::uniform_int_distribution<size_t> pick(0, special.size() - 1);
+    auto isSpecial = [&special](uint8_t c) {
+        return memchr(special.data(), c, special.size()) != nullptr;
+    };
+
+    Buffer_t frame(length);
+    for (auto &c : frame) {
+        if (density.percent < 0) {
+            c = static_cast<uint8_t>(byte(rng));
+        } else if (static_cast<int>(percent(rng)) < density.percent) {
+            c = special[pick(rng)];
+        } else {
+            do {
+                c = static_cast<uint8_t>(byte(rng));
+            } while (isSpecial(c));
+        }
+    }
+    return frame;
+}
+
+/* Repeat fn until minTime has passed, doubling the batch each round */
+template <typename Fn>
+Result measure(size_t frameLength, std::chrono::nanoseconds minTime, Fn &&fn)
+{
+    typedef std::chrono::steady_clock clock;
+
+    fn(); // warm up caches and the branch predictor
+    size_t rounds = 1;
+    while (true) {
+        auto start = clock::now();
+        for (size_t i = 0; i < rounds; i++) {
+            fn();
+        }
+        auto elapsed = clock::now() - start;
+        if (elapsed >= minTime) {
+            double ns =
+                std::chrono::duration<double, std::nano>(elapsed).count() /
+                static_cast<double>(rounds);
+            return {ns, (ns > 0) ? (1e3 * frameLength / ns) : 0};
+        }
+        rounds *= 2;
+    }
+}
+
+void printRecord(bool json, bool first, const char *variant,
+                 const char *operation, size_t frameLength,
+                 const char *density, const Result &result)
+{
+    if (json) {
+        printf("%s\n  {\"variant\": \"%s\", \"operation\": \"%s\", "
+               "\"frame_size\": %zu, \"density\": \"%s\", "
+               "\"ns_per_frame\": %.1f, \"mb_per_s\": %.1f}",
+               first ? "" : ",", variant, operation, frameLength, density,
+               result.nsPerFrame, result.megabytesPerSecond);
+    } else {
+        printf("%s,%s,%zu,%s,%.1f,%.1f\n", variant, operation, frameLength,
+               density, result.nsPerFrame, result.megabytesPerSecond);
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool json = false;
+    const char *filter = nullptr;
+    long minTimeMs = 50;
+
+    int param;
+    while ((param = getopt(argc, argv, "jv:t:")) > 0) {
+        switch (param) {
+        case 'j':
+            json = true;
+            break;
+        case 'v':
+            filter = optarg;
+            break;
+        case 't':
+            minTimeMs = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr,
+                    "Usage: %s [-j] [-v variant] [-t ms]\n"
+                    "  -j  JSON instead of CSV\n"
+                    "  -v  only variants starting with this prefix\n"
+                    "  -t  minimum time per measurement\n",
+                    *argv);
+            return EXIT_FAILURE;
+        }
+    }
+    const std::chrono::milliseconds minTime(minTimeMs);
+
+    if (json) {
+        printf("[");
+    } else {
+        printf("variant,operation,frame_size,density,ns_per_frame,mb_per_s\n");
+    }
+
+    bool first = true;
+    std::mt19937 rng(1055);
+    Buffer_t encoded(2 * SLIP_OUT_FRAME_LENGTH);
+    Buffer_t decoded(2 * SLIP_IN_FRAME_LENGTH);
+    for (const auto &variant : variants) {
+        if (filter != nullptr &&
+            strncmp(variant.name, filter, strlen(filter)) != 0) {
+            continue;
+        }
+        if (variant.isa > slip_cpu_isa()) {
+            fprintf(stderr, "%s: not supported by this CPU, skipped\n",
+                    variant.name);
+            continue;
+        }
+
+        for (size_t frameLength : frameSizes) {
+            for (const auto &density : densities) {
+                Buffer_t frame =
+                    makeFrame(frameLength, density, variant.special, rng);
+                size_t encodedSize = 0;
+                size_t decodedSize = 0;
+                if (variant.encode(frame, frameLength, encoded,
+                                   &encodedSize) != SLIP_OK ||
+                    variant.decode(encoded, encodedSize, decoded,
+                                   &decodedSize) != SLIP_OK ||
+                    decodedSize != frameLength) {
+                    fprintf(stderr, "%s: round trip failed (%zu, %s)\n",
+                            variant.name, frameLength, density.name);
+                    return EXIT_FAILURE;
+                }
+
+                Result encode = measure(frameLength, minTime, [&] {
+                    variant.encode(frame, frameLength, encoded, &encodedSize);
+                });
+                printRecord(json, first, variant.name, "encode", frameLength,
+                            density.name, encode);
+                first = false;
+
+                Result decode = measure(frameLength, minTime, [&] {
+                    variant.decode(encoded, encodedSize, decoded,
+                                   &decodedSize);
+                });
+                printRecord(json, first, variant.name, "decode", frameLength,
+                            density.name, decode);
+            }
+        }
+    }
+
+    if (json) {
+        printf("\n]\n");
+    }
+    return EXIT_SUCCESS;
+}
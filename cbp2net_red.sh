@@ -8,6 +8,9 @@ IPV4_ETH=172.29.250.202/28
 IPV4_RED=172.29.250.203/29
 IPV4_BLK=172.29.250.204/29
 
+# Optional: socket path to run the RED processing in a process of its own
+RED_SHM=${RED_SHM:-}
+
 set -e
 set -u
 set -x
@@ -40,6 +43,13 @@ ip link show ${TAP_NAME}
 ip addr show dev ${TAP_NAME}
 ip route list
 
+# RED process attached to the shared rings of the TAP side
+if [ -n "${RED_SHM}" ]; then
+    ${1} -i ${TAP_NAME} -d /dev/qspi_bypass -x ${RED_SHM} -v &
+    until [ -S ${RED_SHM} ]; do sleep 1; done
+    exec ${1} -X ${RED_SHM} -v # verbose
+fi
+
 #TODO Start in background
 ${1} -i ${TAP_NAME} -d /dev/qspi_bypass -v # verbose
 
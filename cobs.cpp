@@ -0,0 +1,273 @@
+#include "cobs.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/* Length of the next block starting at inIndex, including its zero byte */
+inline size_t cobs_block(const uint8_t *frame, size_t inIndex,
+                         size_t frameLength, bool *zero)
+{
+    size_t length =
+        std::min<size_t>(frameLength - inIndex, COBS_MAX_BLOCK - 1);
+    const auto *end =
+        static_cast<const uint8_t *>(memchr(frame + inIndex, 0, length));
+    *zero = (end != nullptr);
+    return *zero ? static_cast<size_t>(end - (frame + inIndex)) : length;
+}
+
+/* The code byte of every block length */
+constexpr std::array<uint8_t, 256> makeCodes()
+{
+    std::array<uint8_t, 256> table{};
+    for (unsigned c = 0; c < table.size(); c++) {
+        table[c] = static_cast<uint8_t>(c);
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> cobsCodes = makeCodes();
+
+/* Encode into raw output storage */
+enum slip_result cobs_encode_to(const uint8_t *data, size_t frameLength,
+                                uint8_t *output, size_t outputLength,
+                                size_t *outputSize)
+{
+    size_t inIndex = 0;
+    size_t outputIndex = 0;
+    while (true) {
+        bool zero = false;
+        size_t run = cobs_block(data, inIndex, frameLength, &zero);
+
+        // Check if we ran out of space on the output (block and delimiter)
+        if (outputLength < outputIndex + run + 2) {
+            SPDLOG_ERROR("COBS buffer overflow error!");
+            return SLIP_BUFFER_OVERFLOW;
+        }
+
+        output[outputIndex] = static_cast<uint8_t>(run + 1);
+        memcpy(output + outputIndex + 1, data + inIndex, run);
+        outputIndex += run + 1;
+        inIndex += run + (zero ? 1 : 0);
+
+        // A full block is not followed by a zero byte, a final zero byte
+        // needs an empty block behind it
+        if (inIndex == frameLength && !(zero && run < COBS_MAX_BLOCK - 1)) {
+            break;
+        }
+    }
+
+    // Mark the frame end
+    output[outputIndex] = COBS_END;
+
+    // Return the output size
+    *outputSize = outputIndex + 1;
+    return SLIP_OK;
+}
+
+} // namespace
+
+enum slip_result cobs_encode(const inBuffer_t &frame, size_t frameLength,
+                             Buffer_t &output, size_t *outputSize)
+{
+    Expects(frameLength <= frame.size());
+
+    return cobs_encode_to(frame.data(), frameLength, output.data(),
+                          output.size(), outputSize);
+}
+
+enum slip_result cobs_encode_batch(const inBuffer_t *frames, size_t frameCount,
+                                   Buffer_t &output, size_t *outputSize,
+                                   size_t *encodedCount)
+{
+    size_t outputIndex = 0;
+    size_t count = 0;
+    for (; count < frameCount; count++) {
+        const inBuffer_t &frame = frames[count];
+        if (count > 0 &&
+            output.size() - outputIndex <
+                cobs_max_encoded_length(frame.size())) {
+            break;
+        }
+
+        size_t encodedSize = 0;
+        enum slip_result result = cobs_encode_to(
+            frame.data(), frame.size(), output.data() + outputIndex,
+            output.size() - outputIndex, &encodedSize);
+        if (result != SLIP_OK) {
+            return result;
+        }
+        outputIndex += encodedSize;
+    }
+
+    *outputSize = outputIndex;
+    *encodedCount = count;
+    return SLIP_OK;
+}
+
+enum slip_result cobs_encode_iov(const inBuffer_t &frame, size_t frameLength,
+                                 struct iovec *iov, size_t iovLength,
+                                 size_t *iovCount)
+{
+    Expects(frameLength <= frame.size());
+
+    const uint8_t *data = frame.data();
+    size_t count = 0;
+    auto append = [iov, iovLength, &count](const uint8_t *base,
+                                           size_t length) {
+        if (iovLength <= count) {
+            return false;
+        }
+        // NOTE: writev() does not write to the buffers
+        iov[count].iov_base = const_cast<uint8_t *>(base);
+        iov[count].iov_len = length;
+        count++;
+        return true;
+    };
+
+    size_t inIndex = 0;
+    while (true) {
+        bool zero = false;
+        size_t run = cobs_block(data, inIndex, frameLength, &zero);
+        if (!append(&cobsCodes[run + 1], 1) ||
+            (run > 0 && !append(data + inIndex, run))) {
+            SPDLOG_ERROR("COBS iovec overflow error!");
+            return SLIP_BUFFER_OVERFLOW;
+        }
+        inIndex += run + (zero ? 1 : 0);
+
+        if (inIndex == frameLength && !(zero && run < COBS_MAX_BLOCK - 1)) {
+            break;
+        }
+    }
+
+    // Mark the frame end
+    if (!append(&cobsCodes[COBS_END], 1)) {
+        SPDLOG_ERROR("COBS iovec overflow error!");
+        return SLIP_BUFFER_OVERFLOW;
+    }
+
+    *iovCount = count;
+    return SLIP_OK;
+}
+
+enum slip_result cobs_decode(const inBuffer_t &encodedFrame, size_t frameLength,
+                             Buffer_t &output, size_t *outputSize)
+{
+    Expects(frameLength <= encodedFrame.size());
+
+    // Decode up to the delimiter
+    const uint8_t *data = encodedFrame.data();
+    const auto *end =
+        static_cast<const uint8_t *>(memchr(data, COBS_END, frameLength));
+    if (end != nullptr) {
+        frameLength = static_cast<size_t>(end - data);
+    }
+
+    size_t inIndex = 0;
+    size_t outputIndex = 0;
+    while (inIndex < frameLength) {
+        size_t code = data[inIndex];
+        size_t run = code - 1;
+        if (inIndex + code > frameLength) {
+            // Block cut short, complain on stderr
+            SPDLOG_ERROR("COBS block error! (Input byte at({}): {:#04x})",
+                         inIndex, code);
+            *outputSize = outputIndex;
+            return SLIP_INVALID_ESCAPE;
+        }
+
+        // The zero byte behind the block is implicit at the frame end
+        bool zero = (code < COBS_MAX_BLOCK && inIndex + code < frameLength);
+        if (output.size() < outputIndex + run + (zero ? 1 : 0)) {
+            SPDLOG_ERROR("COBS buffer overflow error!");
+            return SLIP_BUFFER_OVERFLOW;
+        }
+
+        memcpy(output.data() + outputIndex, data + inIndex + 1, run);
+        outputIndex += run;
+        if (zero) {
+            output[outputIndex] = 0;
+            outputIndex++;
+        }
+        inIndex += code;
+    }
+
+    *outputSize = outputIndex;
+    return SLIP_OK;
+}
+
+void CobsDecoder::drop(bool resync)
+{
+    frameLength = 0;
+    remaining = 0;
+    zeroPending = false;
+    discard = resync;
+    errorCount++;
+}
+
+bool CobsDecoder::consume(const inBuffer_t &chunk, size_t chunkLength,
+                          size_t *inIndex)
+{
+    const uint8_t *data = chunk.data();
+    if (discard) {
+        // Resync, everything up to the next delimiter is broken
+        const auto *end = static_cast<const uint8_t *>(
+            memchr(data + *inIndex, COBS_END, chunkLength - *inIndex));
+        *inIndex = (end != nullptr) ? static_cast<size_t>(end - data) + 1
+                                    : chunkLength;
+        discard = (end == nullptr);
+        return false;
+    }
+
+    if (remaining == 0) {
+        uint8_t code = data[*inIndex];
+        *inIndex += 1;
+        if (code == COBS_END) {
+            bool ready = (frameLength > 0);
+            zeroPending = false;
+            if (ready) {
+                frameCount++;
+            }
+            return ready;
+        }
+
+        // The previous block ended with a zero byte
+        if (zeroPending) {
+            if (frame.size() <= frameLength) {
+                SPDLOG_ERROR("COBS buffer overflow error!");
+                drop(true);
+                return false;
+            }
+            frame[frameLength] = 0;
+            frameLength++;
+        }
+        remaining = code - 1;
+        zeroPending = (code < COBS_MAX_BLOCK);
+        return false;
+    }
+
+    // Copy the data run of the block
+    size_t run = std::min(remaining, chunkLength - *inIndex);
+    const auto *end =
+        static_cast<const uint8_t *>(memchr(data + *inIndex, COBS_END, run));
+    if (end != nullptr) {
+        // Block cut short by a delimiter, it starts the next frame
+        SPDLOG_ERROR("COBS block error! ({} bytes missing)", remaining);
+        *inIndex = static_cast<size_t>(end - data) + 1;
+        drop(false);
+        return false;
+    }
+    if (frame.size() < frameLength + run) {
+        SPDLOG_ERROR("COBS buffer overflow error!");
+        drop(true);
+        return false;
+    }
+
+    memcpy(frame.data() + frameLength, data + *inIndex, run);
+    frameLength += run;
+    remaining -= run;
+    *inIndex += run;
+    return false;
+}
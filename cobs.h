@@ -0,0 +1,164 @@
+/**
+ * @file COBS encode/decode functions
+ *
+ * Consistent Overhead Byte Stuffing: the frame is split into blocks that end
+ * at a zero byte or after 254 data bytes, every block starts with a code byte
+ * (its length + 1) and a zero byte delimits the frames. The overhead is at
+ * most one byte per 254, independent of the payload.
+ */
+
+#pragma once
+
+#include "framing.h"
+
+enum
+{
+    COBS_END = 0x00,
+    COBS_MAX_BLOCK = 0xFF,
+    COBS_OUT_FRAME_LENGTH = FRAMING_IN_FRAME_LENGTH +
+        FRAMING_IN_FRAME_LENGTH / (COBS_MAX_BLOCK - 1) + 2,
+};
+
+/* Longest encoded frame, including the delimiter */
+constexpr size_t cobs_max_encoded_length(size_t frameLength)
+{
+    return frameLength + frameLength / (COBS_MAX_BLOCK - 1) + 2;
+}
+
+/**
+ * Encode a frame, it is terminated by COBS_END
+ * @param frame             Data to encode
+ * @param frameLength       Data length
+ * @param output            Where to store the encoded frame
+ * @param outputSize        Where to store output length
+ * @return SLIP_OK for success, otherwise error code
+ */
+enum slip_result cobs_encode(const inBuffer_t &frame, size_t frameLength,
+                             Buffer_t &output, size_t *outputSize);
+
+/**
+ * Encode a batch of frames back to back into one buffer
+ * @see slip_encode_batch()
+ */
+enum slip_result cobs_encode_batch(const inBuffer_t *frames, size_t frameCount,
+                                   Buffer_t &output, size_t *outputSize,
+                                   size_t *encodedCount);
+
+/**
+ * Encode a frame as a scatter-gather list for writev(), no payload byte is
+ * copied. The data runs point into frame, the code bytes and the delimiter
+ * point at static storage.
+ * @see slip_encode_iov()
+ */
+enum slip_result cobs_encode_iov(const inBuffer_t &frame, size_t frameLength,
+                                 struct iovec *iov, size_t iovLength,
+                                 size_t *iovCount);
+
+/**
+ * Decode a COBS frame up to the first COBS_END
+ * @param encodedFrame      Data to decode
+ * @param frameLength       Data length
+ * @param output            Where to store the decoded data
+ * @param outputSize        Where to store output length
+ * @return SLIP_OK for success, SLIP_INVALID_ESCAPE if a block is cut short,
+ *         otherwise error code
+ */
+enum slip_result cobs_decode(const inBuffer_t &encodedFrame, size_t frameLength,
+                             Buffer_t &output, size_t *outputSize);
+
+/**
+ * Same interface as FrameCodec, to select COBS as template parameter
+ */
+struct CobsCodec
+{
+    static enum slip_result encode(enum slip_isa /*isa*/,
+                                   const inBuffer_t &frame, size_t frameLength,
+                                   Buffer_t &output, size_t *outputSize)
+    {
+        return cobs_encode(frame, frameLength, output, outputSize);
+    }
+
+    static enum slip_result encodeBatch(enum slip_isa /*isa*/,
+                                        const inBuffer_t *frames,
+                                        size_t frameCount, Buffer_t &output,
+                                        size_t *outputSize,
+                                        size_t *encodedCount)
+    {
+        return cobs_encode_batch(frames, frameCount, output, outputSize,
+                                 encodedCount);
+    }
+
+    static constexpr size_t maxEncodedLength(size_t frameLength)
+    {
+        return cobs_max_encoded_length(frameLength);
+    }
+
+    static enum slip_result encodeIov(const inBuffer_t &frame,
+                                      size_t frameLength, struct iovec *iov,
+                                      size_t iovLength, size_t *iovCount)
+    {
+        return cobs_encode_iov(frame, frameLength, iov, iovLength, iovCount);
+    }
+};
+
+/**
+ * Incremental COBS decoder for the serial byte stream.
+ * Same interface as StreamDecoder. The block state is kept across chunks, a
+ * broken frame is dropped and the decoder resyncs at the next COBS_END.
+ */
+class CobsDecoder
+{
+public:
+    explicit CobsDecoder(size_t maxFrameLength = FRAMING_IN_FRAME_LENGTH)
+        : frame(maxFrameLength)
+    {}
+
+    /**
+     * Decode a chunk of the stream
+     * @param chunk             Raw data from the serial port
+     * @param chunkLength       Data length
+     * @param onFrame           Called with an inBuffer_t for every frame
+     * @return Number of frames found in this chunk
+     */
+    template <typename Callback>
+    size_t feed(const inBuffer_t &chunk, size_t chunkLength,
+                Callback &&onFrame)
+    {
+        Expects(chunkLength <= chunk.size());
+
+        size_t count = 0;
+        size_t inIndex = 0;
+        while (inIndex < chunkLength) {
+            if (consume(chunk, chunkLength, &inIndex)) {
+                onFrame(inBuffer_t(frame.data(), frameLength));
+                frameLength = 0;
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /* Frames decoded so far */
+    size_t frames() const { return frameCount; }
+
+    /* Frames dropped so far (block cut short or too long) */
+    size_t errors() const { return errorCount; }
+
+    /* No CRC trailer with COBS, for the StreamDecoder interface */
+    size_t crcErrors() const { return 0; }
+
+private:
+    /* Decode from *inIndex on, true if a complete frame is ready */
+    bool consume(const inBuffer_t &chunk, size_t chunkLength, size_t *inIndex);
+
+    /* Drop the current frame, skip input up to the next COBS_END if resync */
+    void drop(bool resync);
+
+    Buffer_t frame;
+    size_t frameLength = 0;
+    size_t remaining = 0;     // data bytes left in the current block
+    bool zeroPending = false; // the current block ends with a zero byte
+    bool discard = false;     // looking for the next COBS_END
+    size_t frameCount = 0;
+    size_t errorCount = 0;
+};
@@ -0,0 +1,98 @@
+#include "crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define CRC32C_X86_SSE42 1
+#    include <nmmintrin.h>
+#endif
+
+namespace {
+
+// Reflected polynomial 0x1EDC6F41
+constexpr uint32_t CRC32C_POLY = 0x82F63B78;
+
+typedef std::array<std::array<uint32_t, 256>, 8> crc32cTables_t;
+
+/* Slicing-by-8: table[k][b] is the CRC of b followed by k zero bytes */
+constexpr crc32cTables_t makeTables()
+{
+    crc32cTables_t table{};
+    for (uint32_t b = 0; b < 256; b++) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+        }
+        table[0][b] = crc;
+    }
+    for (uint32_t b = 0; b < 256; b++) {
+        for (size_t k = 1; k < table.size(); k++) {
+            uint32_t crc = table[k - 1][b];
+            table[k][b] = (crc >> 8) ^ table[0][crc & 0xFF];
+        }
+    }
+    return table;
+}
+
+constexpr crc32cTables_t crc32cTables = makeTables();
+
+#ifdef CRC32C_X86_SSE42
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_update_hw(uint32_t crc, const uint8_t *data, size_t length)
+{
+    while (length > 0 && (reinterpret_cast<uintptr_t>(data) & 7) != 0) {
+        crc = _mm_crc32_u8(crc, *data++);
+        length--;
+    }
+#    ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += sizeof(word);
+    }
+    crc = static_cast<uint32_t>(crc64);
+#    endif
+    for (; length > 0; length--) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+#endif
+
+} // namespace
+
+uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *data, size_t length)
+{
+    const auto &t = crc32cTables;
+    for (; length >= 8; length -= 8) {
+        // NOTE: little endian, as the reflected CRC
+        uint32_t low = crc ^
+            (data[0] | (data[1] << 8) | (data[2] << 16) |
+             (static_cast<uint32_t>(data[3]) << 24));
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+            t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^ t[3][data[4]] ^
+            t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        data += 8;
+    }
+    for (; length > 0; length--) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+    }
+    return crc;
+}
+
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t length)
+{
+#ifdef CRC32C_X86_SSE42
+    static const bool sse42 = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("sse4.2") != 0;
+    }();
+    if (sse42) {
+        return crc32c_update_hw(crc, data, length);
+    }
+#endif
+    return crc32c_update_sw(crc, data, length);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file CRC32C (Castagnoli) checksum
+ *
+ * Uses the SSE4.2 crc32 instruction where the CPU has it, a slicing-by-8
+ * table otherwise.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum : uint32_t
+{
+    CRC32C_INIT = 0xFFFFFFFF,
+    // Register value after a frame followed by its CRC (little endian)
+    CRC32C_RESIDUE = 0xB798B438,
+};
+
+/**
+ * Continue a CRC32C over more data
+ * @param crc               CRC32C_INIT or the result of a previous update
+ * @param data              Data to add
+ * @param length            Data length
+ * @return The updated CRC register, complement it for the final value
+ */
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * Table driven CRC32C, the fallback of crc32c_update()
+ */
+uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *data, size_t length);
+
+/**
+ * CRC32C of a whole buffer
+ */
+inline uint32_t crc32c(const uint8_t *data, size_t length)
+{
+    return ~crc32c_update(CRC32C_INIT, data, length);
+}
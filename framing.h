@@ -0,0 +1,1221 @@
+/**
+ * @file Byte-stuffing frame codec, a template over the framing policy
+ *
+ * A framing policy names the frame delimiter, the escape byte, how a byte is
+ * escaped and which control characters have to be escaped (ACCM). The byte
+ * classes are constexpr lookup tables generated from the policy, so every
+ * framing compiles to its own loop without runtime checks of the mode.
+ */
+
+#pragma once
+
+#include "crc32c.h"
+#include "tun-driver.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <sys/uio.h>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#    define FRAMING_X86_SIMD 1
+#    include <immintrin.h>
+#endif
+
+enum
+{
+    FRAMING_IN_FRAME_LENGTH = 2048,
+};
+
+enum slip_result
+{
+    SLIP_OK = 0,
+    SLIP_INVALID_ESCAPE = 1,
+    SLIP_BUFFER_OVERFLOW = 2,
+    SLIP_CRC_ERROR = 3,
+};
+
+/* Codec kernels, selected at runtime by CPU dispatch */
+enum slip_isa
+{
+    SLIP_ISA_SCALAR = 0,
+    SLIP_ISA_SSE2 = 1,
+    SLIP_ISA_AVX2 = 2,
+};
+
+/* Why a decode kernel stopped */
+enum decode_stop
+{
+    DECODE_MORE = 0,     // all input consumed, the frame continues
+    DECODE_END = 1,      // at the delimiter of the frame
+    DECODE_ESCAPE = 2,   // the input ends inside an escape sequence
+    DECODE_INVALID = 3,  // invalid escape sequence
+    DECODE_OVERFLOW = 4, // ran out of space on the output
+};
+
+/* Class of a received byte */
+enum byte_class
+{
+    BYTE_DATA = 0,
+    BYTE_END = 1,
+    BYTE_ESC = 2,
+    BYTE_IGNORE = 3, // unescaped control character, inserted by the line
+};
+
+typedef gsl::span<uint8_t> inBuffer_t;
+typedef std::vector<uint8_t> Buffer_t;
+
+/**
+ * Best codec kernel supported by this CPU (probed once)
+ */
+inline enum slip_isa slip_cpu_isa()
+{
+#ifdef FRAMING_X86_SIMD
+    static const enum slip_isa isa = [] {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return SLIP_ISA_AVX2;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return SLIP_ISA_SSE2;
+        }
+        return SLIP_ISA_SCALAR;
+    }();
+    return isa;
+#else
+    return SLIP_ISA_SCALAR;
+#endif
+}
+
+/**
+ * Lookup tables generated from a framing policy
+ */
+template <typename Framing>
+struct FramingTables
+{
+    static constexpr bool mustEscape(unsigned c)
+    {
+        return c == Framing::END || c == Framing::ESC ||
+            (c < 0x20 && ((Framing::ACCM >> c) & 1U) != 0);
+    }
+
+    static constexpr std::array<std::array<uint8_t, 2>, 256> makeEscape()
+    {
+        std::array<std::array<uint8_t, 2>, 256> table{};
+        for (unsigned c = 0; c < table.size(); c++) {
+            if (mustEscape(c)) {
+                table[c][0] = Framing::ESC;
+                table[c][1] = Framing::escape(c);
+            }
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint8_t, 256> makeClass()
+    {
+        std::array<uint8_t, 256> table{};
+        for (unsigned c = 0; c < table.size(); c++) {
+            if (c == Framing::END) {
+                table[c] = BYTE_END;
+            } else if (c == Framing::ESC) {
+                table[c] = BYTE_ESC;
+            } else if (mustEscape(c)) {
+                table[c] = BYTE_IGNORE;
+            } else {
+                table[c] = BYTE_DATA;
+            }
+        }
+        return table;
+    }
+
+    static constexpr std::array<uint8_t, 256> makeBytes()
+    {
+        std::array<uint8_t, 256> table{};
+        for (unsigned c = 0; c < table.size(); c++) {
+            table[c] = static_cast<uint8_t>(c);
+        }
+        return table;
+    }
+
+    static constexpr std::array<int16_t, 256> makeUnescape()
+    {
+        std::array<int16_t, 256> table{};
+        for (unsigned c = 0; c < table.size(); c++) {
+            table[c] = Framing::unescape(c);
+        }
+        return table;
+    }
+
+    /* Escape sequence of every byte, {0, 0} if it is sent as it is */
+    static constexpr std::array<std::array<uint8_t, 2>, 256> escape =
+        makeEscape();
+
+    /* Class of every received byte */
+    static constexpr std::array<uint8_t, 256> byteClass = makeClass();
+
+    /* Decoded byte for the second byte of an escape sequence, -1 if invalid */
+    static constexpr std::array<int16_t, 256> unescape = makeUnescape();
+
+    /* Every byte value, static storage for scatter-gather lists */
+    static constexpr std::array<uint8_t, 256> bytes = makeBytes();
+};
+
+/**
+ * Encoder and decoder for one framing policy.
+ * The vector kernels look for candidate bytes (delimiter, escape and, with an
+ * ACCM, all control characters) in a whole vector and confirm them with the
+ * lookup tables. The scalar code is the fallback and handles the tails.
+ * @param Crc               Append a CRC32C trailer to every frame and check
+ *                          it, computed in the same pass as the coding
+ */
+template <typename Framing, bool Crc = false>
+class FrameCodec
+{
+public:
+    typedef FramingTables<Framing> Tables;
+
+    /* Length of the CRC trailer */
+    static constexpr size_t TRAILER_LENGTH = Crc ? sizeof(uint32_t) : 0;
+
+    /**
+     * Encode a frame, it is terminated by the delimiter
+     * @param isa               Kernel to use, falls back to what the CPU has
+     * @param frame             Data to encode
+     * @param frameLength       Data length
+     * @param output            Where to store the encoded frame
+     * @param outputSize        Where to store output length
+     * @return SLIP_OK for success, otherwise error code
+     */
+    static enum slip_result encode(enum slip_isa isa, const inBuffer_t &frame,
+                                   size_t frameLength, Buffer_t &output,
+                                   size_t *outputSize)
+    {
+        Expects(frameLength <= frame.size());
+
+        return encodeTo(isa, frame.data(), frameLength, output.data(),
+                        output.size(), outputSize);
+    }
+
+    /**
+     * Encode a batch of frames back to back into one buffer, to send them
+     * with a single write. The delimiter that ends a frame also starts the
+     * next one. Frames that might not fit are left for the next batch.
+     * @param isa               Kernel to use
+     * @param frames            Frames to encode, one span per frame
+     * @param frameCount        Number of frames
+     * @param output            Where to store the encoded frames
+     * @param outputSize        Where to store output length
+     * @param encodedCount      Where to store the number of frames encoded
+     * @return SLIP_OK for success, otherwise error code of the first frame
+     */
+    static enum slip_result encodeBatch(enum slip_isa isa,
+                                        const inBuffer_t *frames,
+                                        size_t frameCount, Buffer_t &output,
+                                        size_t *outputSize,
+                                        size_t *encodedCount)
+    {
+        size_t outputIndex = 0;
+        size_t count = 0;
+        for (; count < frameCount; count++) {
+            const inBuffer_t &frame = frames[count];
+            if (count > 0 &&
+                output.size() - outputIndex < maxEncodedLength(frame.size())) {
+                break;
+            }
+
+            size_t encodedSize = 0;
+            enum slip_result result =
+                encodeTo(isa, frame.data(), frame.size(),
+                         output.data() + outputIndex,
+                         output.size() - outputIndex, &encodedSize);
+            if (result != SLIP_OK) {
+                return result;
+            }
+            outputIndex += encodedSize;
+        }
+
+        *outputSize = outputIndex;
+        *encodedCount = count;
+        return SLIP_OK;
+    }
+
+    /* Longest encoded frame, including the delimiter */
+    static constexpr size_t maxEncodedLength(size_t frameLength)
+    {
+        return 2 * (frameLength + TRAILER_LENGTH) + 1;
+    }
+
+    /**
+     * Decode a frame up to the first delimiter.
+     * After an invalid escape the rest of the frame is skipped and
+     * SLIP_INVALID_ESCAPE is returned, the output then ends with the escape
+     * byte.
+     * @see encode()
+     */
+    static enum slip_result decode(enum slip_isa isa,
+                                   const inBuffer_t &encodedFrame,
+                                   size_t frameLength, Buffer_t &output,
+                                   size_t *outputSize)
+    {
+        Expects(frameLength <= encodedFrame.size());
+
+        size_t inIndex = 0;
+        size_t outputIndex = 0;
+        uint32_t crc = CRC32C_INIT;
+        enum decode_stop stop =
+            decodeRun(isa, encodedFrame.data(), frameLength, output.data(),
+                      output.size(), &inIndex, &outputIndex, &crc);
+        enum slip_result result =
+            decodeResult(stop, encodedFrame.data(), inIndex, output.data(),
+                         output.size(), outputIndex, outputSize);
+        return (result == SLIP_OK) ? checkCrc(crc, outputSize) : result;
+    }
+
+    /**
+     * Decode a frame in place, up to the first delimiter. The decoded frame
+     * is compacted to the start of the buffer, it is never longer than the
+     * encoded one.
+     * @param frame             Data to decode, overwritten by the result
+     * @param frameLength       Data length
+     * @param decoded           Where to store the span of the decoded frame
+     * @return SLIP_OK for success, otherwise error code
+     * @see decode()
+     */
+    static enum slip_result decodeInPlace(enum slip_isa isa,
+                                          const inBuffer_t &frame,
+                                          size_t frameLength,
+                                          inBuffer_t *decoded)
+    {
+        Expects(frameLength <= frame.size());
+
+        size_t inIndex = 0;
+        size_t outputIndex = 0;
+        size_t outputSize = 0;
+        uint32_t crc = CRC32C_INIT;
+        enum decode_stop stop =
+            decodeRun<true>(isa, frame.data(), frameLength, frame.data(),
+                            frameLength, &inIndex, &outputIndex, &crc);
+        enum slip_result result =
+            decodeResult(stop, frame.data(), inIndex, frame.data(),
+                         frameLength, outputIndex, &outputSize);
+        if (result == SLIP_OK) {
+            result = checkCrc(crc, &outputSize);
+        }
+        *decoded = inBuffer_t(frame.data(), outputSize);
+        return result;
+    }
+
+    /**
+     * Encode a frame as a scatter-gather list for writev(), no payload byte
+     * is copied. Runs that need no escaping point into frame, the escape
+     * sequences and the delimiter point at static storage.
+     * @param frame             Data to encode, must stay valid until written
+     * @param frameLength       Data length
+     * @param iov               Where to store the list
+     * @param iovLength         Number of entries in iov
+     * @param iovCount          Where to store the number of entries used
+     * @return SLIP_OK for success, SLIP_BUFFER_OVERFLOW if iov is too short,
+     *         a frame with many escapes may need more than IOV_MAX entries
+     */
+    static enum slip_result encodeIov(const inBuffer_t &frame,
+                                      size_t frameLength, struct iovec *iov,
+                                      size_t iovLength, size_t *iovCount)
+    {
+        Expects(frameLength <= frame.size());
+
+        static constexpr uint8_t end[] = {Framing::END};
+        const enum slip_isa isa = slip_cpu_isa();
+        const uint8_t *data = frame.data();
+        size_t count = 0;
+        auto append = [iov, iovLength, &count](const uint8_t *base,
+                                               size_t length) {
+            if (iovLength <= count) {
+                return false;
+            }
+            // NOTE: writev() does not write to the buffers
+            iov[count].iov_base = const_cast<uint8_t *>(base);
+            iov[count].iov_len = length;
+            count++;
+            return true;
+        };
+
+        size_t inIndex = 0;
+        uint32_t crc = CRC32C_INIT;
+        while (true) {
+            size_t special = scan(isa, data, inIndex, frameLength);
+            crcUpdate(&crc, data + inIndex,
+                      std::min(special + 1, frameLength) - inIndex);
+            if (special > inIndex &&
+                !append(data + inIndex, special - inIndex)) {
+                break;
+            }
+            if (special == frameLength) {
+                if constexpr (Crc) {
+                    // The trailer bytes point at static storage as well
+                    uint8_t trailer[TRAILER_LENGTH];
+                    storeCrc(crc, trailer);
+                    bool fits = true;
+                    for (uint8_t c : trailer) {
+                        fits = fits &&
+                            ((Tables::escape[c][0] != 0)
+                                 ? append(Tables::escape[c].data(), 2)
+                                 : append(&Tables::bytes[c], 1));
+                    }
+                    if (!fits) {
+                        break;
+                    }
+                }
+
+                // Mark the frame end
+                if (!append(static_cast<const uint8_t *>(end), sizeof(end))) {
+                    break;
+                }
+                *iovCount = count;
+                return SLIP_OK;
+            }
+
+            if (!append(Tables::escape[data[special]].data(), 2)) {
+                break;
+            }
+            inIndex = special + 1;
+        }
+
+        // Not an error, the caller encodes into a buffer instead
+        SPDLOG_TRACE("{} frame needs more than {} iovecs", Framing::name,
+                     iovLength);
+        return SLIP_BUFFER_OVERFLOW;
+    }
+
+    /**
+     * Find the next delimiter, e.g. to resync after an invalid escape
+     * @return Its index, or length if there is none
+     */
+    static size_t findEnd(const inBuffer_t &data, size_t offset, size_t length)
+    {
+        Expects(offset <= length && length <= data.size());
+
+        // NOTE: memchr() is vectorized by the C library already
+        const auto *end = static_cast<const uint8_t *>(
+            memchr(data.data() + offset, Framing::END, length - offset));
+        return (end != nullptr) ? static_cast<size_t>(end - data.data())
+                                : length;
+    }
+
+    /**
+     * Find the next byte that has to be escaped
+     * @return Its index, or length if there is none
+     */
+    static size_t scan(enum slip_isa isa, const uint8_t *data, size_t inIndex,
+                       size_t length)
+    {
+        switch (std::min(isa, slip_cpu_isa())) {
+#ifdef FRAMING_X86_SIMD
+        case SLIP_ISA_AVX2:
+            return scanAvx2(data, inIndex, length);
+        case SLIP_ISA_SSE2:
+            return scanSse2(data, inIndex, length);
+#endif
+        default:
+            return scanScalar(data, inIndex, length);
+        }
+    }
+
+    /**
+     * Decode until the delimiter, the end of the input or an error.
+     * The delimiter itself is not consumed.
+     * @param InPlace           output may alias encodedFrame, never ahead of
+     *                          the input
+     * @param inIndex           Where to start in encodedFrame, updated
+     * @param outputIndex       Where to continue in output, updated
+     * @param crc               CRC register over the output, updated
+     * @return Why decoding stopped
+     */
+    template <bool InPlace = false>
+    static enum decode_stop decodeRun(enum slip_isa isa,
+                                      const uint8_t *encodedFrame,
+                                      size_t frameLength, uint8_t *output,
+                                      size_t outputLength, size_t *inIndex,
+                                      size_t *outputIndex, uint32_t *crc)
+    {
+        switch (std::min(isa, slip_cpu_isa())) {
+#ifdef FRAMING_X86_SIMD
+        case SLIP_ISA_AVX2:
+            return decodeAvx2<InPlace>(encodedFrame, frameLength, output,
+                                       outputLength, inIndex, outputIndex,
+                                       crc);
+        case SLIP_ISA_SSE2:
+            return decodeSse2<InPlace>(encodedFrame, frameLength, output,
+                                       outputLength, inIndex, outputIndex,
+                                       crc);
+#endif
+        default:
+            return decodeScalar(encodedFrame, frameLength, frameLength, output,
+                                outputLength, inIndex, outputIndex, crc);
+        }
+    }
+
+    /**
+     * Decode the escape sequence that starts at *inIndex.
+     * An invalid sequence decodes to the escape byte, only that is consumed.
+     * @return DECODE_MORE for success, otherwise why decoding has to stop
+     */
+    static enum decode_stop decodeEscape(const uint8_t *encodedFrame,
+                                         size_t *inIndex, size_t frameLength,
+                                         uint8_t *output, size_t *outputIndex)
+    {
+        if (*inIndex + 1 >= frameLength) {
+            return DECODE_ESCAPE;
+        }
+
+        uint8_t inByte = encodedFrame[*inIndex + 1];
+        int16_t decoded = Tables::unescape[inByte];
+        if (decoded < 0) {
+            // Escape sequence invalid, complain on stderr
+            SPDLOG_ERROR(
+                "{} escape error! (Input bytes at({}): {:#04x}, {:#04x})",
+                Framing::name, *inIndex, encodedFrame[*inIndex], inByte);
+            output[*outputIndex] = Framing::ESC;
+            *inIndex += 1;
+            *outputIndex += 1;
+            return DECODE_INVALID;
+        }
+
+        output[*outputIndex] = static_cast<uint8_t>(decoded);
+        *inIndex += 2;
+        *outputIndex += 1;
+        return DECODE_MORE;
+    }
+
+    /* Add data to the CRC register, a no-op without the CRC trailer */
+    static void crcUpdate(uint32_t *crc, const uint8_t *data, size_t length)
+    {
+        if constexpr (Crc) {
+            *crc = crc32c_update(*crc, data, length);
+        }
+    }
+
+    /**
+     * Check the CRC register of a decoded frame and strip the trailer
+     * @param crc               CRC register over the frame and its trailer
+     * @param frameLength       Decoded length, updated
+     * @return SLIP_OK for success, SLIP_CRC_ERROR if the frame is corrupted
+     */
+    static enum slip_result checkCrc(uint32_t crc, size_t *frameLength)
+    {
+        if constexpr (Crc) {
+            if (*frameLength < TRAILER_LENGTH || crc != CRC32C_RESIDUE) {
+                SPDLOG_ERROR("{} CRC error! (frame length {})", Framing::name,
+                             *frameLength);
+                return SLIP_CRC_ERROR;
+            }
+            *frameLength -= TRAILER_LENGTH;
+        }
+        return SLIP_OK;
+    }
+
+private:
+    /* Store the final CRC as trailer, little endian */
+    static void storeCrc(uint32_t crc, uint8_t *trailer)
+    {
+        crc = ~crc;
+        for (size_t i = 0; i < TRAILER_LENGTH; i++) {
+            trailer[i] = static_cast<uint8_t>(crc >> (8 * i));
+        }
+    }
+
+    /* Map why decoding stopped to the result of decode() */
+    static enum slip_result decodeResult(enum decode_stop stop,
+                                         const uint8_t *encodedFrame,
+                                         size_t inIndex, uint8_t *output,
+                                         size_t outputLength,
+                                         size_t outputIndex,
+                                         size_t *outputSize)
+    {
+        switch (stop) {
+        case DECODE_ESCAPE:
+            // The frame ends in the middle of an escape sequence
+            SPDLOG_ERROR("{} escape error! (Input byte at({}): {:#04x} at end)",
+                         Framing::name, inIndex, encodedFrame[inIndex]);
+            if (outputLength <= outputIndex) {
+                break;
+            }
+            output[outputIndex] = Framing::ESC;
+            *outputSize = outputIndex + 1;
+            return SLIP_INVALID_ESCAPE;
+        case DECODE_INVALID:
+            // NOTE: the rest of the frame is skipped
+            *outputSize = outputIndex;
+            return SLIP_INVALID_ESCAPE;
+        case DECODE_OVERFLOW:
+            break;
+        default:
+            *outputSize = outputIndex;
+            return SLIP_OK;
+        }
+
+        SPDLOG_ERROR("{} buffer overflow error!", Framing::name);
+        return SLIP_BUFFER_OVERFLOW;
+    }
+
+    static enum slip_result encodeTo(enum slip_isa isa, const uint8_t *frame,
+                                     size_t frameLength, uint8_t *output,
+                                     size_t outputLength, size_t *outputSize)
+    {
+        uint32_t crc = CRC32C_INIT;
+        enum slip_result result;
+        switch (std::min(isa, slip_cpu_isa())) {
+#ifdef FRAMING_X86_SIMD
+        case SLIP_ISA_AVX2:
+            result = encodeAvx2(frame, frameLength, output, outputLength,
+                                outputSize, &crc);
+            break;
+        case SLIP_ISA_SSE2:
+            result = encodeSse2(frame, frameLength, output, outputLength,
+                                outputSize, &crc);
+            break;
+#endif
+        default:
+            result = encodeScalar(frame, 0, frameLength, output, outputLength,
+                                  0, outputSize, &crc);
+            break;
+        }
+
+        if constexpr (Crc) {
+            if (result != SLIP_OK) {
+                return result;
+            }
+
+            // The trailer goes in front of the delimiter, escaped as well
+            uint8_t trailer[TRAILER_LENGTH];
+            storeCrc(crc, trailer);
+            result = encodeScalar(trailer, 0, sizeof(trailer), output,
+                                  outputLength, *outputSize - 1, outputSize,
+                                  &crc);
+        }
+        return result;
+    }
+
+    /**
+     * Encode from inIndex on with exact bounds checks
+     * @param inIndex           Where to start in frame
+     * @param outputIndex       Where to continue in output
+     */
+    static enum slip_result encodeScalar(const uint8_t *frame, size_t inIndex,
+                                         size_t frameLength, uint8_t *output,
+                                         size_t outputLength,
+                                         size_t outputIndex,
+                                         size_t *outputSize, uint32_t *crc)
+    {
+        crcUpdate(crc, frame + inIndex, frameLength - inIndex);
+        for (; inIndex < frameLength; inIndex++) {
+            // Grab one byte from the input and check if we need to escape it
+            const auto &sequence = Tables::escape[frame[inIndex]];
+            size_t needed = (sequence[0] != 0) ? 2 : 1;
+
+            // Check if we ran out of space on the output
+            if (outputLength < outputIndex + needed) {
+                SPDLOG_ERROR("{} buffer overflow error!", Framing::name);
+                return SLIP_BUFFER_OVERFLOW;
+            }
+
+            if (sequence[0] != 0) {
+                output[outputIndex] = sequence[0];
+                output[outputIndex + 1] = sequence[1];
+            } else {
+                // No need to escape, copy as it is
+                output[outputIndex] = frame[inIndex];
+            }
+            outputIndex += needed;
+        }
+
+        // Mark the frame end
+        if (outputLength <= outputIndex) {
+            SPDLOG_ERROR("{} buffer overflow error!", Framing::name);
+            return SLIP_BUFFER_OVERFLOW;
+        }
+        output[outputIndex] = Framing::END;
+
+        // Return the output size
+        *outputSize = outputIndex + 1;
+        return SLIP_OK;
+    }
+
+    /* Encode length bytes, the caller has checked the output has room */
+    static size_t encodeBytes(const uint8_t *frame, size_t length,
+                              uint8_t *output)
+    {
+        size_t outputIndex = 0;
+        for (size_t i = 0; i < length; i++) {
+            const auto &sequence = Tables::escape[frame[i]];
+            if (sequence[0] != 0) {
+                output[outputIndex] = sequence[0];
+                output[outputIndex + 1] = sequence[1];
+                outputIndex += 2;
+            } else {
+                output[outputIndex] = frame[i];
+                outputIndex += 1;
+            }
+        }
+        return outputIndex;
+    }
+
+    /**
+     * Decode up to stopIndex (an escape may reach beyond) with exact bounds
+     * checks
+     * @see decodeRun()
+     */
+    static enum decode_stop decodeScalar(const uint8_t *encodedFrame,
+                                         size_t stopIndex, size_t frameLength,
+                                         uint8_t *output, size_t outputLength,
+                                         size_t *inIndex, size_t *outputIndex,
+                                         uint32_t *crc)
+    {
+        const size_t outputStart = *outputIndex;
+        enum decode_stop stop = DECODE_MORE;
+        while (*inIndex < stopIndex) {
+            uint8_t inByte = encodedFrame[*inIndex];
+            uint8_t byteClass = Tables::byteClass[inByte];
+            if (byteClass == BYTE_END) {
+                // End of packet, stop the loop
+                stop = DECODE_END;
+                break;
+            }
+            if (byteClass == BYTE_IGNORE) {
+                *inIndex += 1;
+                continue;
+            }
+
+            // Check if we ran out of space on the output buffer
+            if (outputLength <= *outputIndex) {
+                stop = DECODE_OVERFLOW;
+                break;
+            }
+
+            if (byteClass == BYTE_ESC) {
+                stop = decodeEscape(encodedFrame, inIndex, frameLength, output,
+                                    outputIndex);
+                if (stop != DECODE_MORE) {
+                    break;
+                }
+            } else {
+                output[*outputIndex] = inByte;
+                *inIndex += 1;
+                *outputIndex += 1;
+            }
+        }
+
+        crcUpdate(crc, output + outputStart, *outputIndex - outputStart);
+        return stop;
+    }
+
+    static size_t scanScalar(const uint8_t *data, size_t inIndex,
+                             size_t length)
+    {
+        while (inIndex < length && Tables::escape[data[inIndex]][0] == 0) {
+            inIndex++;
+        }
+        return inIndex;
+    }
+
+#ifdef FRAMING_X86_SIMD
+
+    /*
+     * The vector kernels compare a whole vector against the candidate bytes.
+     * A clean vector is stored as it is. With a single candidate the vector
+     * is stored anyway and the kernel advances by the clean run in front of
+     * it, then handles the candidate. Decoding in place copies only the run,
+     * the store could overwrite input that is not read yet. Denser vectors go
+     * through the table driven code. Encoding needs two vectors of headroom
+     * in the output, decoding one since the output is never longer than the
+     * input. The rest is left to the exact scalar code.
+     */
+
+    /**
+     * crcUpdate() inlined into the AVX2 kernels, every CPU with AVX2 has the
+     * SSE4.2 crc32 instruction. The CRC of a vector is computed while it is
+     * still in the registers.
+     */
+    __attribute__((target("sse4.2"), always_inline)) static inline void
+    crcUpdateSse42(uint32_t *crc, const uint8_t *data, size_t length)
+    {
+        if constexpr (Crc) {
+#    ifdef __x86_64__
+            uint64_t crc64 = *crc;
+            for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, data, sizeof(word));
+                crc64 = _mm_crc32_u64(crc64, word);
+                data += sizeof(word);
+            }
+            *crc = static_cast<uint32_t>(crc64);
+#    endif
+            for (; length > 0; length--) {
+                *crc = _mm_crc32_u8(*crc, *data++);
+            }
+        }
+    }
+
+    __attribute__((target("sse2"))) static unsigned candidatesSse2(__m128i v)
+    {
+        __m128i hits = _mm_or_si128(
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(Framing::END))),
+            _mm_cmpeq_epi8(v, _mm_set1_epi8(static_cast<char>(Framing::ESC))));
+        if constexpr (Framing::ACCM != 0) {
+            // Unsigned v <= 0x1f
+            hits = _mm_or_si128(
+                hits, _mm_cmpeq_epi8(_mm_min_epu8(v, _mm_set1_epi8(0x1f)), v));
+        }
+        return static_cast<unsigned>(_mm_movemask_epi8(hits));
+    }
+
+    __attribute__((target("avx2"))) static unsigned candidatesAvx2(__m256i v)
+    {
+        __m256i hits = _mm256_or_si256(
+            _mm256_cmpeq_epi8(
+                v, _mm256_set1_epi8(static_cast<char>(Framing::END))),
+            _mm256_cmpeq_epi8(
+                v, _mm256_set1_epi8(static_cast<char>(Framing::ESC))));
+        if constexpr (Framing::ACCM != 0) {
+            // Unsigned v <= 0x1f
+            hits = _mm256_or_si256(
+                hits,
+                _mm256_cmpeq_epi8(_mm256_min_epu8(v, _mm256_set1_epi8(0x1f)),
+                                  v));
+        }
+        return static_cast<unsigned>(_mm256_movemask_epi8(hits));
+    }
+
+    __attribute__((target("sse2"))) static enum slip_result
+    encodeSse2(const uint8_t *frame, size_t frameLength, uint8_t *output,
+               size_t outputLength, size_t *outputSize, uint32_t *crc)
+    {
+        constexpr size_t width = sizeof(__m128i);
+
+        size_t inIndex = 0;
+        size_t outputIndex = 0;
+        while (inIndex + width <= frameLength &&
+               outputIndex + 2 * width <= outputLength) {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(frame + inIndex));
+            unsigned mask = candidatesSse2(v);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(output + outputIndex),
+                             v);
+            if (mask == 0) {
+                crcUpdate(crc, frame + inIndex, width);
+                inIndex += width;
+                outputIndex += width;
+                continue;
+            }
+            if ((mask & (mask - 1)) != 0) {
+                crcUpdate(crc, frame + inIndex, width);
+                outputIndex +=
+                    encodeBytes(frame + inIndex, width, output + outputIndex);
+                inIndex += width;
+                continue;
+            }
+
+            size_t run = __builtin_ctz(mask);
+            crcUpdate(crc, frame + inIndex, run + 1);
+            inIndex += run;
+            outputIndex += run;
+            outputIndex +=
+                encodeBytes(frame + inIndex, 1, output + outputIndex);
+            inIndex += 1;
+        }
+
+        return encodeScalar(frame, inIndex, frameLength, output, outputLength,
+                            outputIndex, outputSize, crc);
+    }
+
+    __attribute__((target("avx2,sse4.2"))) static enum slip_result
+    encodeAvx2(const uint8_t *frame, size_t frameLength, uint8_t *output,
+               size_t outputLength, size_t *outputSize, uint32_t *crc)
+    {
+        constexpr size_t width = sizeof(__m256i);
+
+        size_t inIndex = 0;
+        size_t outputIndex = 0;
+        while (inIndex + width <= frameLength &&
+               outputIndex + 2 * width <= outputLength) {
+            __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(frame + inIndex));
+            unsigned mask = candidatesAvx2(v);
+            _mm256_storeu_si256(
+                reinterpret_cast<__m256i *>(output + outputIndex), v);
+            if (mask == 0) {
+                crcUpdateSse42(crc, frame + inIndex, width);
+                inIndex += width;
+                outputIndex += width;
+                continue;
+            }
+            if ((mask & (mask - 1)) != 0) {
+                crcUpdateSse42(crc, frame + inIndex, width);
+                outputIndex +=
+                    encodeBytes(frame + inIndex, width, output + outputIndex);
+                inIndex += width;
+                continue;
+            }
+
+            size_t run = __builtin_ctz(mask);
+            crcUpdateSse42(crc, frame + inIndex, run + 1);
+            inIndex += run;
+            outputIndex += run;
+            outputIndex +=
+                encodeBytes(frame + inIndex, 1, output + outputIndex);
+            inIndex += 1;
+        }
+
+        return encodeScalar(frame, inIndex, frameLength, output, outputLength,
+                            outputIndex, outputSize, crc);
+    }
+
+    template <bool InPlace>
+    __attribute__((target("sse2"))) static enum decode_stop
+    decodeSse2(const uint8_t *encodedFrame, size_t frameLength, uint8_t *output,
+               size_t outputLength, size_t *inIndexPtr, size_t *outputIndexPtr,
+               uint32_t *crc)
+    {
+        constexpr size_t width = sizeof(__m128i);
+
+        size_t inIndex = *inIndexPtr;
+        size_t outputIndex = *outputIndexPtr;
+        enum decode_stop stop = DECODE_MORE;
+        while (inIndex + width <= frameLength &&
+               outputIndex + width <= outputLength) {
+            __m128i v = _mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(encodedFrame + inIndex));
+            unsigned mask = candidatesSse2(v);
+            if (mask == 0) {
+                _mm_storeu_si128(
+                    reinterpret_cast<__m128i *>(output + outputIndex), v);
+                crcUpdate(crc, output + outputIndex, width);
+                inIndex += width;
+                outputIndex += width;
+                continue;
+            }
+
+            // Dense vectors and the candidate byte of a single one
+            size_t stopIndex = inIndex + width;
+            if ((mask & (mask - 1)) == 0) {
+                size_t run = __builtin_ctz(mask);
+                if constexpr (InPlace) {
+                    // A vector store would overwrite input not read yet
+                    memmove(output + outputIndex, encodedFrame + inIndex, run);
+                } else {
+                    _mm_storeu_si128(
+                        reinterpret_cast<__m128i *>(output + outputIndex), v);
+                }
+                crcUpdate(crc, output + outputIndex, run);
+                inIndex += run;
+                outputIndex += run;
+                stopIndex = inIndex + 1;
+            }
+            stop = decodeScalar(encodedFrame, stopIndex, frameLength, output,
+                                outputLength, &inIndex, &outputIndex, crc);
+            if (stop != DECODE_MORE) {
+                break;
+            }
+        }
+
+        if (stop == DECODE_MORE) {
+            stop = decodeScalar(encodedFrame, frameLength, frameLength, output,
+                                outputLength, &inIndex, &outputIndex, crc);
+        }
+        *inIndexPtr = inIndex;
+        *outputIndexPtr = outputIndex;
+        return stop;
+    }
+
+    template <bool InPlace>
+    __attribute__((target("avx2,sse4.2"))) static enum decode_stop
+    decodeAvx2(const uint8_t *encodedFrame, size_t frameLength, uint8_t *output,
+               size_t outputLength, size_t *inIndexPtr, size_t *outputIndexPtr,
+               uint32_t *crc)
+    {
+        constexpr size_t width = sizeof(__m256i);
+
+        size_t inIndex = *inIndexPtr;
+        size_t outputIndex = *outputIndexPtr;
+        enum decode_stop stop = DECODE_MORE;
+        while (inIndex + width <= frameLength &&
+               outputIndex + width <= outputLength) {
+            __m256i v = _mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(encodedFrame + inIndex));
+            unsigned mask = candidatesAvx2(v);
+            if (mask == 0) {
+                _mm256_storeu_si256(
+                    reinterpret_cast<__m256i *>(output + outputIndex), v);
+                crcUpdateSse42(crc, output + outputIndex, width);
+                inIndex += width;
+                outputIndex += width;
+                continue;
+            }
+
+            // Dense vectors and the candidate byte of a single one
+            size_t stopIndex = inIndex + width;
+            if ((mask & (mask - 1)) == 0) {
+                size_t run = __builtin_ctz(mask);
+                if constexpr (InPlace) {
+                    // A vector store would overwrite input not read yet
+                    memmove(output + outputIndex, encodedFrame + inIndex, run);
+                } else {
+                    _mm256_storeu_si256(
+                        reinterpret_cast<__m256i *>(output + outputIndex), v);
+                }
+                crcUpdateSse42(crc, output + outputIndex, run);
+                inIndex += run;
+                outputIndex += run;
+                stopIndex = inIndex + 1;
+            }
+            stop = decodeScalar(encodedFrame, stopIndex, frameLength, output,
+                                outputLength, &inIndex, &outputIndex, crc);
+            if (stop != DECODE_MORE) {
+                break;
+            }
+        }
+
+        if (stop == DECODE_MORE) {
+            stop = decodeScalar(encodedFrame, frameLength, frameLength, output,
+                                outputLength, &inIndex, &outputIndex, crc);
+        }
+        *inIndexPtr = inIndex;
+        *outputIndexPtr = outputIndex;
+        return stop;
+    }
+
+    __attribute__((target("sse2"))) static size_t
+    scanSse2(const uint8_t *data, size_t inIndex, size_t length)
+    {
+        constexpr size_t width = sizeof(__m128i);
+
+        while (inIndex + width <= length) {
+            unsigned mask = candidatesSse2(_mm_loadu_si128(
+                reinterpret_cast<const __m128i *>(data + inIndex)));
+            if (mask == 0) {
+                inIndex += width;
+                continue;
+            }
+
+            size_t candidate = inIndex + __builtin_ctz(mask);
+            if (Tables::escape[data[candidate]][0] != 0) {
+                return candidate;
+            }
+            inIndex = candidate + 1;
+        }
+        return scanScalar(data, inIndex, length);
+    }
+
+    __attribute__((target("avx2"))) static size_t
+    scanAvx2(const uint8_t *data, size_t inIndex, size_t length)
+    {
+        constexpr size_t width = sizeof(__m256i);
+
+        while (inIndex + width <= length) {
+            unsigned mask = candidatesAvx2(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i *>(data + inIndex)));
+            if (mask == 0) {
+                inIndex += width;
+                continue;
+            }
+
+            size_t candidate = inIndex + __builtin_ctz(mask);
+            if (Tables::escape[data[candidate]][0] != 0) {
+                return candidate;
+            }
+            inIndex = candidate + 1;
+        }
+        return scanScalar(data, inIndex, length);
+    }
+
+#endif
+};
+
+/**
+ * Incremental decoder for the serial byte stream.
+ * Chunks of any size are fed in as they are read, every complete frame in a
+ * chunk is handed to a callback. Escape state is kept across chunks, a broken
+ * frame is dropped and the decoder resyncs at the next delimiter.
+ * A frame that starts in a chunk is decoded in place, only a frame that
+ * continues in the next chunk is copied to the decoder's frame buffer.
+ * With Crc, frames failing the CRC32C trailer check are dropped and counted.
+ */
+template <typename Framing, bool Crc = false>
+class StreamDecoder
+{
+public:
+    typedef FrameCodec<Framing, Crc> Codec;
+
+    explicit StreamDecoder(size_t maxFrameLength = FRAMING_IN_FRAME_LENGTH)
+        : frame(maxFrameLength)
+    {}
+
+    /**
+     * Decode a chunk of the stream
+     * @param chunk             Raw data from the serial port, overwritten
+     * @param chunkLength       Data length
+     * @param onFrame           Called with an inBuffer_t for every frame
+     * @return Number of frames found in this chunk
+     */
+    template <typename Callback>
+    size_t feed(const inBuffer_t &chunk, size_t chunkLength,
+                Callback &&onFrame)
+    {
+        Expects(chunkLength <= chunk.size());
+
+        size_t count = 0;
+        size_t inIndex = 0;
+        inBuffer_t decoded;
+        while (inIndex < chunkLength) {
+            if (consume(chunk, chunkLength, &inIndex, &decoded)) {
+                onFrame(decoded);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    /* Frames decoded so far */
+    size_t frames() const { return frameCount; }
+
+    /* Frames dropped so far (invalid escape, too long or CRC error) */
+    size_t errors() const { return errorCount; }
+
+    /* Frames dropped so far because of a CRC error */
+    size_t crcErrors() const { return crcErrorCount; }
+
+private:
+    /* Decode from *inIndex on, true if a complete frame is in *decoded */
+    bool consume(const inBuffer_t &chunk, size_t chunkLength, size_t *inIndex,
+                 inBuffer_t *decoded)
+    {
+        if (discard) {
+            // Resync, everything up to the next delimiter is broken
+            size_t end = Codec::findEnd(chunk, *inIndex, chunkLength);
+            *inIndex = std::min(end + 1, chunkLength);
+            discard = (end == chunkLength);
+            return false;
+        }
+
+        // A new frame is decoded in place, behind the input
+        bool inPlace = (frameLength == 0 && !escape);
+        uint8_t *output = frame.data();
+        size_t outputLength = frame.size();
+        size_t outputIndex = frameLength;
+        if (inPlace) {
+            output = chunk.data() + *inIndex;
+            outputLength = std::min(outputLength, chunkLength - *inIndex);
+            crc = CRC32C_INIT;
+        }
+
+        enum decode_stop stop = DECODE_MORE;
+        if (escape) {
+            // Finish the escape sequence split by the previous chunk
+            const uint8_t sequence[2] = {Framing::ESC, chunk[*inIndex]};
+            size_t index = 0;
+            escape = false;
+            if (outputLength <= outputIndex) {
+                stop = DECODE_OVERFLOW;
+            } else {
+                stop = Codec::decodeEscape(
+                    static_cast<const uint8_t *>(sequence), &index,
+                    sizeof(sequence), output, &outputIndex);
+                Codec::crcUpdate(&crc, output + outputIndex - 1, 1);
+                // NOTE: an invalid sequence consumes only the escape byte
+                *inIndex += index - 1;
+            }
+        }
+        if (stop == DECODE_MORE) {
+            stop = inPlace
+                ? Codec::template decodeRun<true>(
+                      slip_cpu_isa(), chunk.data(), chunkLength, output,
+                      outputLength, inIndex, &outputIndex, &crc)
+                : Codec::decodeRun(slip_cpu_isa(), chunk.data(), chunkLength,
+                                   output, outputLength, inIndex,
+                                   &outputIndex, &crc);
+        }
+
+        switch (stop) {
+        case DECODE_MORE:
+        case DECODE_ESCAPE:
+            // The frame continues in the next chunk
+            if (inPlace) {
+                memcpy(frame.data(), output, outputIndex);
+            }
+            frameLength = outputIndex;
+            if (stop == DECODE_ESCAPE) {
+                escape = true;
+                *inIndex = chunkLength;
+            }
+            return false;
+        case DECODE_END:
+            *inIndex += 1;
+            frameLength = 0;
+            if (outputIndex == 0) {
+                // Back-to-back delimiters or line noise flush
+                return false;
+            }
+            if (Codec::checkCrc(crc, &outputIndex) != SLIP_OK) {
+                // The delimiter is consumed already, no resync needed
+                crcErrorCount++;
+                errorCount++;
+                return false;
+            }
+            frameCount++;
+            *decoded = inBuffer_t(output, outputIndex);
+            return true;
+        case DECODE_OVERFLOW:
+            SPDLOG_ERROR("{} buffer overflow error!", Framing::name);
+            drop();
+            return false;
+        default:
+            drop();
+            return false;
+        }
+    }
+
+    /* Drop the current frame and skip input up to the next delimiter */
+    void drop()
+    {
+        frameLength = 0;
+        escape = false;
+        discard = true;
+        errorCount++;
+    }
+
+    Buffer_t frame;
+    size_t frameLength = 0;
+    bool escape = false;        // the last chunk ended with the escape byte
+    bool discard = false;       // looking for the next delimiter
+    uint32_t crc = CRC32C_INIT; // over the frame decoded so far
+    size_t frameCount = 0;
+    size_t errorCount = 0;
+    size_t crcErrorCount = 0;
+};
+
+/**
+ * HDLC-like async framing as used by PPP (RFC 1662): 0x7E flag, 0x7D escape,
+ * the escaped byte is XOR 0x20
+ * @param Accm              Async control character map, 0x00..0x1f
+ */
+template <uint32_t Accm = 0xffffffff>
+struct HdlcFraming
+{
+    static constexpr const char *name = "HDLC";
+    static constexpr uint8_t END = 0x7E;
+    static constexpr uint8_t ESC = 0x7D;
+    static constexpr uint32_t ACCM = Accm;
+
+    static constexpr uint8_t escape(unsigned c)
+    {
+        return static_cast<uint8_t>(c ^ 0x20);
+    }
+
+    static constexpr int16_t unescape(unsigned c)
+    {
+        // NOTE: 0x7D 0x7E aborts the frame
+        return (c == END) ? -1 : static_cast<int16_t>(c ^ 0x20);
+    }
+};
+
+typedef HdlcFraming<> PppFraming;
@@ -1,12 +1,18 @@
+#include "cobs.h"
 #include "slip.h"
 #include "tun-driver.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <libserialport.h>
+#include <poll.h>
 #include <pthread.h>
+#include <sys/uio.h>
 
 struct CommDevices
 {
@@ -18,15 +24,70 @@ char adapterName[IF_NAMESIZE];
 char serialPortName[128];
 unsigned serialBaudRate = 9600;
 
-static void *serialToTun(void *ptr);
-static void *tunToSerial(void *ptr);
+// Most packets taken from the TUN interface for one serial write
+constexpr size_t TUN_BATCH_FRAMES = 8;
+
+enum framing_t
+{
+    FRAMING_SLIP = 0,
+    FRAMING_HDLC = 1,
+    FRAMING_COBS = 2,
+};
+enum framing_t serialFraming = FRAMING_SLIP;
+
+// Append and check a CRC32C trailer on every frame (SLIP and HDLC)
+bool serialCrc = false;
+
+template <typename Decoder> static void *serialToTun(void *ptr);
+template <typename Codec> static void *tunToSerial(void *ptr);
+
+/**
+ * Write a whole scatter-gather list, waits for the port if it is busy
+ * @param fd        - The serial port's file descriptor
+ * @return Bytes written, or -1 on error
+ */
+static ssize_t writev_all(int fd, struct iovec *iov, size_t iovCount)
+{
+    ssize_t total = 0;
+    while (iovCount > 0) {
+        ssize_t written =
+            writev(fd, iov, std::min<size_t>(iovCount, IOV_MAX));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN) {
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                poll(&pfd, 1, -1);
+                continue;
+            }
+            return -1;
+        }
+        total += written;
+
+        // Skip what was written, a partly written entry is adjusted
+        while (iovCount > 0 && static_cast<size_t>(written) >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovCount--;
+        }
+        if (iovCount > 0) {
+            iov->iov_base = static_cast<uint8_t *>(iov->iov_base) + written;
+            iov->iov_len -= written;
+        }
+    }
+    return total;
+}
 
 /**
  * Handles getting packets from the serial port and writing them to the TUN
  * interface
+ * @param Decoder   - SlipDecoder, StreamDecoder<PppFraming> or CobsDecoder,
+ *                    with the CRC variants frames failing the check are
+ *                    dropped before they reach the interface
  * @param ptr       - Pointer to the CommDevices struct
  */
-static void *serialToTun(void *ptr)
+template <typename Decoder> static void *serialToTun(void *ptr)
 {
     // Grab thread parameters
     struct CommDevices *args = static_cast<struct CommDevices *>(ptr);
@@ -34,15 +95,13 @@ static void *serialToTun(void *ptr)
     int tunFd = args->tunFileDescriptor;
     struct sp_port *serialPort = args->serialPort;
 
-    // Create two buffers, one to store raw data from the serial port and
-    // one to store SLIP frames
+    // Raw data from the serial port, frames are decoded in place. The
+    // decoder keeps frames that span reads and its escape state.
     Buffer_t inBuffer(SLIP_IN_FRAME_LENGTH);
-    Buffer_t outBuffer(SLIP_OUT_FRAME_LENGTH);
-    size_t outSize = 0;
-    int inIndex = 0;
+    Decoder decoder;
 
-    // Incoming byte count
-    size_t count;
+    // Dropped frames reported so far
+    size_t reportedErrors = 0;
 
     // Serial result
     enum sp_return serialResult;
@@ -55,34 +114,25 @@ static void *serialToTun(void *ptr)
     while (true) {
         // Wait for the event (RX Ready)
         sp_wait(eventSet, 0);
-        count = sp_input_waiting(serialPort); // Bytes ready for reading
 
-        // Read bytes from serial
-        serialResult =
-            sp_blocking_read(serialPort, &inBuffer[inIndex], count, 0);
+        // Read as many bytes as are ready
+        serialResult = sp_nonblocking_read(serialPort, inBuffer.data(),
+                                           inBuffer.size());
 
         if (serialResult < 0) {
             std::cerr << "Serial error! " << serialResult << std::endl;
         } else {
-            // We need to check if there is an SLIP_END sequence in the new
-            // bytes
-            for (int i = 0; i < serialResult; i++) {
-                if (inBuffer[inIndex] == SLIP_END) {
-                    // Decode the packet that is marked by SLIP_END
-                    slip_decode(inBuffer, inIndex, outBuffer, &outSize);
-
-                    // Write the packet to the virtual interface
-                    write(tunFd, outBuffer.data(), outSize);
-
-                    // Copy the remaining data (belonging to the next packet)
-                    // to the start of the buffer
-                    memcpy(inBuffer.data(), &inBuffer[inIndex + 1],
-                           serialResult - i - 1);
-                    inIndex = serialResult - i - 1;
-                    break;
-                }
-
-                inIndex++;
+            // Write every packet completed by the new bytes to the virtual
+            // interface
+            decoder.feed(inBuffer, serialResult,
+                         [tunFd](const inBuffer_t &frame) {
+                             write(tunFd, frame.data(), frame.size());
+                         });
+            if (decoder.errors() != reportedErrors) {
+                reportedErrors = decoder.errors();
+                std::cerr << "Dropped frames: " << reportedErrors << " ("
+                          << decoder.crcErrors() << " CRC errors)"
+                          << std::endl;
             }
         }
     }
@@ -90,7 +140,14 @@ static void *serialToTun(void *ptr)
     return ptr;
 }
 
-static void *tunToSerial(void *ptr)
+/**
+ * Handles getting packets from the TUN interface and writing them to the
+ * serial port. Packets queued on the interface are sent as one batch.
+ * @param Codec     - FrameCodec<SlipFraming>, FrameCodec<PppFraming> or
+ *                    CobsCodec, the FrameCodec ones optionally with CRC
+ * @param ptr       - Pointer to the CommDevices struct
+ */
+template <typename Codec> static void *tunToSerial(void *ptr)
 {
     // Grab thread parameters
     struct CommDevices *args = static_cast<struct CommDevices *>(ptr);
@@ -98,32 +155,70 @@ static void *tunToSerial(void *ptr)
     int tunFd = args->tunFileDescriptor;
     struct sp_port *serialPort = args->serialPort;
 
-    // Create TUN buffer
-    Buffer_t inBuffer(SLIP_IN_FRAME_LENGTH);
-    Buffer_t outBuffer(SLIP_OUT_FRAME_LENGTH);
+    // Create TUN buffers, the encoded frames point into them
+    std::vector<Buffer_t> inBuffers(TUN_BATCH_FRAMES,
+                                    Buffer_t(SLIP_IN_FRAME_LENGTH));
+    std::vector<inBuffer_t> frames;
+    frames.reserve(TUN_BATCH_FRAMES);
+    std::vector<struct iovec> iov(IOV_MAX);
+    size_t iovCount = 0;
+
+    // Encoded batch, also used for frames with too many escapes for one
+    // writev()
+    Buffer_t outBuffer(TUN_BATCH_FRAMES * SLIP_OUT_FRAME_LENGTH);
 
     // Incoming byte count
     ssize_t count;
 
     // Encoded data size
-    unsigned long encodedLength = 0;
+    size_t encodedLength = 0;
+    size_t encodedCount = 0;
 
     // Serial error messages
-    enum sp_return serialResult;
+    ssize_t serialResult;
 
+    int serialFd = -1;
+    sp_get_port_handle(serialPort, &serialFd);
+
+    struct pollfd pfd = {tunFd, POLLIN, 0};
     while (true) {
-        count = read(tunFd, inBuffer.data(), inBuffer.size());
-        if (count < 0) {
-            std::cerr << "Could not read from interface\n";
+        // Wait for a packet, then take what else is queued without blocking
+        frames.clear();
+        do {
+            Buffer_t &inBuffer = inBuffers[frames.size()];
+            count = read(tunFd, inBuffer.data(), inBuffer.size());
+            if (count < 0) {
+                std::cerr << "Could not read from interface\n";
+                break;
+            }
+            frames.emplace_back(inBuffer.data(), (size_t)count);
+        } while (frames.size() < inBuffers.size() && poll(&pfd, 1, 0) > 0);
+        if (frames.empty()) {
             continue;
         }
 
-        // Encode data
-        slip_encode(inBuffer, (size_t)count, outBuffer, &encodedLength);
-
-        // Write to serial port
-        serialResult =
-            sp_nonblocking_write(serialPort, outBuffer.data(), encodedLength);
+        // Encode data and write to serial port, a single packet is not
+        // copied
+        if (frames.size() == 1 &&
+            Codec::encodeIov(frames[0], frames[0].size(), iov.data(),
+                             iov.size(), &iovCount) == SLIP_OK) {
+            serialResult = writev_all(serialFd, iov.data(), iovCount);
+        } else {
+            // The batch in one write per filled outBuffer, the frames that
+            // do not fit are left for the next one
+            serialResult = 0;
+            for (size_t done = 0; done < frames.size() && serialResult >= 0;
+                 done += encodedCount) {
+                if (Codec::encodeBatch(slip_cpu_isa(), frames.data() + done,
+                                       frames.size() - done, outBuffer,
+                                       &encodedLength,
+                                       &encodedCount) != SLIP_OK) {
+                    break;
+                }
+                struct iovec batch = {outBuffer.data(), encodedLength};
+                serialResult = writev_all(serialFd, &batch, 1);
+            }
+        }
         if (serialResult < 0) {
             std::cerr << "Could not send data to serial port: " << serialResult
                       << std::endl;
@@ -133,11 +228,25 @@ static void *tunToSerial(void *ptr)
     return ptr;
 }
 
+/**
+ * Start both threads for one framing
+ * @param Codec     - Encoder of tunToSerial()
+ * @param Decoder   - Decoder of serialToTun()
+ */
+template <typename Codec, typename Decoder>
+static void startThreads(pthread_t *tun2serial, pthread_t *serial2tun,
+                         struct CommDevices *threadParams)
+{
+    pthread_create(tun2serial, NULL, tunToSerial<Codec>, (void *)threadParams);
+    pthread_create(serial2tun, NULL, serialToTun<Decoder>,
+                   (void *)threadParams);
+}
+
 int main(int argc, char *argv[])
 {
     // Grab parameters
     int param;
-    while ((param = getopt(argc, argv, "i:p:b:")) > 0) {
+    while ((param = getopt(argc, argv, "i:p:b:f:c")) > 0) {
         switch (param) {
         case 'i':
             strncpy(static_cast<char *>(adapterName), optarg, IFNAMSIZ - 1);
@@ -149,6 +258,22 @@ int main(int argc, char *argv[])
         case 'b':
             serialBaudRate = strtoul(optarg, NULL, 10);
             break;
+        case 'f':
+            if (strcmp(optarg, "slip") == 0) {
+                serialFraming = FRAMING_SLIP;
+            } else if (strcmp(optarg, "hdlc") == 0) {
+                serialFraming = FRAMING_HDLC;
+            } else if (strcmp(optarg, "cobs") == 0) {
+                serialFraming = FRAMING_COBS;
+            } else {
+                std::cerr << "Unknown framing " << optarg
+                          << " (slip|hdlc|cobs)\n";
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'c':
+            serialCrc = true;
+            break;
         default:
             std::cerr << "Unknown parameter " << param << std::endl;
             break;
@@ -163,6 +288,10 @@ int main(int argc, char *argv[])
         std::cerr << "Serial port required (-p)\n";
         return EXIT_FAILURE;
     }
+    if (serialCrc && serialFraming == FRAMING_COBS) {
+        std::cerr << "CRC trailer needs -f slip|hdlc\n";
+        return EXIT_FAILURE;
+    }
 
     int tunFd = tun_open_common(static_cast<char *>(adapterName), VTUN_P2P);
     if (tunFd < 0) {
@@ -212,8 +341,31 @@ int main(int argc, char *argv[])
     threadParams.serialPort = serialPort;
 
     puts("Starting threads");
-    pthread_create(&tun2serial, NULL, tunToSerial, (void *)&threadParams);
-    pthread_create(&serial2tun, NULL, serialToTun, (void *)&threadParams);
+    switch (serialFraming) {
+    case FRAMING_HDLC:
+        if (serialCrc) {
+            startThreads<FrameCodec<PppFraming, true>,
+                         StreamDecoder<PppFraming, true>>(
+                &tun2serial, &serial2tun, &threadParams);
+        } else {
+            startThreads<FrameCodec<PppFraming>, StreamDecoder<PppFraming>>(
+                &tun2serial, &serial2tun, &threadParams);
+        }
+        break;
+    case FRAMING_COBS:
+        startThreads<CobsCodec, CobsDecoder>(&tun2serial, &serial2tun,
+                                             &threadParams);
+        break;
+    default:
+        if (serialCrc) {
+            startThreads<FrameCodec<SlipFraming, true>, SlipCrcDecoder>(
+                &tun2serial, &serial2tun, &threadParams);
+        } else {
+            startThreads<FrameCodec<SlipFraming>, SlipDecoder>(
+                &tun2serial, &serial2tun, &threadParams);
+        }
+        break;
+    }
 
     pthread_join(tun2serial, NULL);
     puts("Thread tun-to-network returned");
@@ -1,5 +1,16 @@
+#include "EpollReactor.h"
+#include "ExtensionChain.h"
 #include "ExtensionPoint.h"
+#include "FrameReader.h"
+#include "FrameWriter.h"
+#include "Handoff.h"
+#include "ShmPipe.h"
+#include "IoUring.h"
+#include "PacketPool.h"
+#include "cobs.h"
 
+#include <algorithm>
+#include <arpa/inet.h>
 #include <array>
 #include <chrono>
 #include <climits>
@@ -7,17 +18,80 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <mutex>
+#include <poll.h>
+#include <sys/stat.h>
+#include <system_error>
 #include <thread>
+#include <type_traits>
+#include <vector>
 using namespace std::literals;
 
-class CommDevices
+/* Settings shared by all CommDevices, whatever their extension */
+class CommConfig
 {
 public:
-    typedef std::shared_ptr<ExtensionPoint> extensionPtr_t;
+    /* true if the transport and the TAP can be spliced, see
+     * tapToSerialSplice(). Never on Linux 5.10 and later, tun has no splice
+     * support there. */
+    static bool spliceCapable(int serialFd, int tapFd);
+
+    /* Serial link framing: length header (default) or COBS */
+    static bool cobsFraming;
+
+    /* TAP opened with IFF_VNET_HDR, frames are GSO super-frames */
+    static bool offload;
+
+    /* Largest frame on the TAP side */
+    static size_t frameLength()
+    {
+        return offload ? TUN_OFFLOAD_FRAME_LENGTH : ETHER_FRAME_LENGTH;
+    }
+
+    /* Frames to the serial port are packed into transfers of up to
+     * batchSize bytes (0: one write per frame), a frame waits at most
+     * batchDelay for more */
+    static size_t batchSize;
+    static std::chrono::microseconds batchDelay;
+
+    /* Frames go through kernel pipes with splice(), length header framing
+     * only */
+    static bool splicePassthrough;
+
+    /* Reads kept posted on the TAP by forwardUring() */
+    static constexpr size_t URING_READS = 8;
+
+    /* Reads per readable fd and wakeup in runReactor(), so that one busy fd
+     * does not starve the others */
+    static constexpr size_t REACTOR_BUDGET = 16;
+
+    /* Serializes frames written to the serial port, there is one tapToSerial
+     * thread per TAP queue */
+    static std::mutex serialWriteMutex;
+
+    /* Buffers the packets for the extension are read into and handed on in,
+     * nullptr copies them into the extension */
+    static std::shared_ptr<PacketPool> packetPool;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    static void wait100ms() { std::this_thread::sleep_for(100ms); }
+};
+
+/**
+ * The forwarding engines for one TAP queue. Extension is the type of the
+ * RED node: NoExtension without one, a concrete class such as Pipe to call
+ * it without virtual dispatch, or ExtensionPoint for any implementation.
+ */
+template <typename Extension = ExtensionPoint>
+class CommDevices : public CommConfig
+{
+public:
+    typedef std::shared_ptr<Extension> extensionPtr_t;
 
     CommDevices(int tapFd, int serialFd, enum tun_mode_t _mode,
                 extensionPtr_t optional)
@@ -29,11 +103,95 @@ public:
     void tapToSerial();
     void readInBound();
     void readOutBound();
-
-    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-    static void wait100ms() { std::this_thread::sleep_for(100ms); }
+    void forwardUring(IoUring *ring);
+    void runReactor();
 
 private:
+    void serialToTapCobs();
+    bool serialToTapSplice();
+    bool tapToSerialSplice();
+    bool writeInBound(const char *frame, ssize_t length);
+    bool writeInBound(gsl::span<const ExtensionPoint::Packet> packets);
+    void tapToExtension();
+    bool serialWritePacket(const void *buf, size_t count);
+    bool tapWritePacket(const void *buf, size_t count);
+
+    /* false at compile time without an extension */
+    bool hasExtension() const
+    {
+        if constexpr (std::is_same<Extension, NoExtension>::value) {
+            return false;
+        } else {
+            return extensionPoint != nullptr;
+        }
+    }
+
+    // NOTE: a known type is called directly, the object has to be of
+    // exactly that type then
+    static constexpr bool dynamic =
+        std::is_same<Extension, ExtensionPoint>::value;
+
+    ssize_t extensionRead(ExtensionPoint::Channel id, void *buf, size_t count)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->read(id, buf, count);
+        } else {
+            return extensionPoint->Extension::read(id, buf, count);
+        }
+    }
+    ssize_t extensionWrite(ExtensionPoint::Channel id, const void *buf,
+                           size_t count)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->write(id, buf, count);
+        } else {
+            return extensionPoint->Extension::write(id, buf, count);
+        }
+    }
+    ssize_t extensionReadBatch(ExtensionPoint::Channel id,
+                               gsl::span<ExtensionPoint::Packet> packets)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->readBatch(id, packets);
+        } else {
+            return extensionPoint->Extension::readBatch(id, packets);
+        }
+    }
+    ssize_t extensionWriteBatch(ExtensionPoint::Channel id,
+                                gsl::span<const ExtensionPoint::Packet> packets)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->writeBatch(id, packets);
+        } else {
+            return extensionPoint->Extension::writeBatch(id, packets);
+        }
+    }
+    bool extensionWritePacket(ExtensionPoint::Channel id, PacketRef packet)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->writePacket(id, std::move(packet));
+        } else {
+            return extensionPoint->Extension::writePacket(id,
+                                                          std::move(packet));
+        }
+    }
+    PacketRef extensionReadPacket(ExtensionPoint::Channel id)
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->readPacket(id, *packetPool);
+        } else {
+            return extensionPoint->Extension::readPacket(id, *packetPool);
+        }
+    }
+    int extensionFileno(ExtensionPoint::Channel id) const
+    {
+        if constexpr (dynamic) {
+            return extensionPoint->fileno(id);
+        } else {
+            return extensionPoint->Extension::fileno(id);
+        }
+    }
+
     const int tapFileDescriptor;
     const int serialFileDescriptor;
     const enum tun_mode_t mode;
@@ -44,6 +202,14 @@ char adapterName[IF_NAMESIZE] = {};
 char serialDevice[_POSIX_PATH_MAX] = {};
 
 volatile bool __io_canceled = false;
+bool CommConfig::cobsFraming = false;
+bool CommConfig::offload = false;
+size_t CommConfig::batchSize = 0;
+bool CommConfig::splicePassthrough = false;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+std::chrono::microseconds CommConfig::batchDelay(200);
+std::mutex CommConfig::serialWriteMutex;
+std::shared_ptr<PacketPool> CommConfig::packetPool;
 
 static void signal_handler(int sig)
 {
@@ -55,20 +221,31 @@ static void signal_handler(int sig)
  * Handles getting packets from the serial port and writing them to the TAP
  * interface
  */
-void CommDevices::serialToTap()
+template <typename Extension>
+void CommDevices<Extension>::serialToTap()
 {
+    if (cobsFraming) {
+        serialToTapCobs();
+        return;
+    }
+    if (splicePassthrough && serialToTapSplice()) {
+        return;
+    }
+
     // Grab thread parameters
-    const int tapFd = this->tapFileDescriptor;
     const int serialFd = this->serialFileDescriptor;
 
-    // Create TAP buffer
-    std::array<char, ETHER_FRAME_LENGTH> inBuffer{};
+    // Keeps partial frames across reads, a super-frame comes in pieces
+    FrameReader reader(frameLength());
 
     while (io_is_enabled()) {
         // Read bytes from serial
         // Incoming byte count
-        ssize_t serialResult =
-            frame_read(serialFd, inBuffer.data(), inBuffer.size());
+        ssize_t serialResult = reader.fill(serialFd);
+        if (serialResult < 0 && errno == EAGAIN) {
+            (void)io_wait(serialFd, POLLIN);
+            continue;
+        }
         if (serialResult <= 0) {
             SPDLOG_ERROR("Serial read error({}) {}", errno, strerror(errno));
             wait100ms();
@@ -77,77 +254,953 @@ void CommDevices::serialToTap()
             if (this->mode == VTUN_PIPE) {
                 // selftest only:
                 char pingMsg[] = "\x05\0TapPing";
-                serialResult = sizeof(pingMsg);
                 // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-                memcpy(inBuffer.data(), pingMsg, sizeof(pingMsg));
+                (void)writeInBound(pingMsg, sizeof(pingMsg));
             }
+#endif
+            continue;
+        }
+
+        // Write every packet completed by the new bytes to the virtual
+        // interface, or as one batch to the extension. A joined frame is
+        // gone with the next next(), the batch is written before.
+        std::array<ExtensionPoint::Packet, ExtensionPoint::MAX_BATCH> batch{};
+        size_t batched = 0;
+        const char *frame = nullptr;
+        size_t length = 0;
+        while (reader.next(&frame, &length)) {
+            if (!hasExtension()) {
+                if (!writeInBound(frame, static_cast<ssize_t>(length))) {
+                    wait100ms();
+                }
+                continue;
+            }
+            batch[batched++] = {const_cast<char *>(frame), length};
+            if (batched == batch.size() || reader.joined()) {
+                (void)writeInBound({batch.data(), batched});
+                batched = 0;
+            }
+        }
+        if (batched > 0) {
+            (void)writeInBound({batch.data(), batched});
+        }
+    }
+
+    SPDLOG_INFO("serialToTap thread stopped");
+}
+
+/**
+ * Same as serialToTap() for a COBS framed serial link, a read may return
+ * any part of the byte stream
+ */
+template <typename Extension>
+void CommDevices<Extension>::serialToTapCobs()
+{
+    const int serialFd = this->serialFileDescriptor;
+
+    // Raw data from the serial port, the decoder keeps the frames and its
+    // block state across reads
+    std::array<uint8_t, COBS_OUT_FRAME_LENGTH> inBuffer{};
+    CobsDecoder decoder(offload ? frameLength() : ETHER_FRAME_LEN_MASK);
+
+    while (io_is_enabled()) {
+        ssize_t serialResult = read(serialFd, inBuffer.data(), inBuffer.size());
+        if (serialResult < 0 && errno == EAGAIN) {
+            (void)io_wait(serialFd, POLLIN);
+            continue;
+        }
+        if (serialResult <= 0) {
+            SPDLOG_ERROR("Serial read error({}) {}", errno, strerror(errno));
+            wait100ms();
+            continue;
+        }
+
+        // Write every packet completed by the new bytes
+        decoder.feed(inBuffer, serialResult, [this](const inBuffer_t &frame) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            (void)writeInBound(reinterpret_cast<const char *>(frame.data()),
+                               frame.size());
+        });
+    }
+
+    SPDLOG_INFO("serialToTap thread stopped");
+}
+
+/**
+ * Write a packet from the serial link to the TAP interface or extension
+ * @return false on error
+ */
+template <typename Extension>
+bool CommDevices<Extension>::writeInBound(const char *frame, ssize_t length)
+{
+    ssize_t count;
+    if (hasExtension()) {
+        count = extensionWrite(ExtensionPoint::OUTER, frame, length);
+    } else {
+        count = write(tapFileDescriptor, frame, length);
+    }
+    if (count != length) {
+        SPDLOG_ERROR("InBound write error({}) {}", errno, strerror(errno));
+        return false;
+    }
+
+#ifndef NDEBUG
+    if (!hasExtension()) {
+        SPDLOG_TRACE(" serialToTap {}:{:n}", count,
+                     spdlog::to_hex(frame, frame + count));
+        wait100ms();
+    }
+#endif
+    return true;
+}
+
+/**
+ * Write the packets from the serial link to the extension, one writeBatch()
+ * @return false on error, the packets not written are dropped
+ */
+template <typename Extension>
+bool CommDevices<Extension>::writeInBound(
+    gsl::span<const ExtensionPoint::Packet> packets)
+{
+    ssize_t written = extensionWriteBatch(ExtensionPoint::OUTER, packets);
+    if (written != static_cast<ssize_t>(packets.size())) {
+        SPDLOG_ERROR("InBound write error({}) {}, {} packets dropped", errno,
+                     strerror(errno),
+                     packets.size() - std::max<ssize_t>(written, 0));
+        wait100ms();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Both directions of serialToTap() and tapToSerial() on one io_uring, for the
+ * length header framing. URING_READS reads stay posted on the TAP, every
+ * buffer goes read -> write -> read again. The frames for the serial port
+ * are written as one linked chain per batch, so they stay in order, and a
+ * short write is resumed where it stopped. The serial port is a byte
+ * stream: one read at a time goes into a FrameReader, the frames it finds
+ * are copied to the TAP write buffers. Completions are reaped from the
+ * shared ring, the only syscall is one io_uring_enter() per batch.
+ */
+template <typename Extension>
+void CommDevices<Extension>::forwardUring(IoUring *ring)
+{
+    enum : uint64_t
+    {
+        TAP_READ,
+        SERIAL_WRITE,
+        SERIAL_READ,
+        TAP_WRITE,
+        TICK,
+    };
+    auto tag = [](uint64_t op, size_t slot) { return (op << 32) | slot; };
+
+    const int tapFd = this->tapFileDescriptor;
+    const int serialFd = this->serialFileDescriptor;
+
+    // One slot per posted read, room for the length header in front
+    const size_t slotLength = sizeof(uint16_t) + frameLength();
+    std::vector<char> arena(2 * URING_READS * slotLength);
+    auto slot = [&arena, slotLength](size_t index) {
+        return arena.data() + index * slotLength;
+    };
+    if (!ring->registerBuffer(arena.data(), arena.size())) {
+        SPDLOG_INFO("io_uring buffers not registered ({})", strerror(errno));
+    }
+
+    // Slots 0..URING_READS-1 are for the TAP reads, the others for the
+    // frames written to the TAP
+    auto postTapRead = [&](size_t index) {
+        ring->prepRead(tapFd, slot(index) + sizeof(uint16_t), frameLength(),
+                       tag(TAP_READ, index));
+    };
+    for (size_t i = 0; i < URING_READS; i++) {
+        postTapRead(i);
+    }
+    std::vector<size_t> tapWriteSlots;
+    for (size_t i = URING_READS; i < 2 * URING_READS; i++) {
+        tapWriteSlots.push_back(i);
+    }
+    ring->prepTimeout(100, tag(TICK, 0));
+
+    // Frames are taken from the reader while there is a free TAP write slot,
+    // the next read is posted once it has no complete frame left
+    FrameReader reader(frameLength());
+    bool serialReading = false;
+    bool drained = true;
+    auto takeFrames = [&]() {
+        const char *frame = nullptr;
+        size_t length = 0;
+        while (!tapWriteSlots.empty()) {
+            if (!reader.next(&frame, &length)) {
+                drained = true;
+                return;
+            }
+            size_t index = tapWriteSlots.back();
+            tapWriteSlots.pop_back();
+            memcpy(slot(index), frame, length);
+            ring->prepWrite(tapFd, slot(index), length, tag(TAP_WRITE, index));
+        }
+        drained = false;
+    };
+    auto postSerialRead = [&]() {
+        size_t room = 0;
+        char *buf = reader.space(&room);
+        ring->prepRead(serialFd, buf, room, tag(SERIAL_READ, 0));
+        serialReading = true;
+    };
+    postSerialRead();
+
+    // Failed reads are posted again at the next tick, not at once
+    std::vector<size_t> tapReadRetries;
+    bool serialReadRetry = false;
+
+    // Serial writes: slot, offset of the rest, rest length
+    struct SerialWrite
+    {
+        size_t index;
+        size_t offset;
+        size_t length;
+    };
+    std::deque<SerialWrite> serialPending;
+    std::vector<SerialWrite> serialInFlight(URING_READS);
+    std::vector<SerialWrite> serialResumed;
+    size_t serialWrites = 0;
+
+    while (io_is_enabled()) {
+        // Start the next chain when the last one is done
+        if (serialWrites == 0 && !serialPending.empty()) {
+            while (!serialPending.empty()) {
+                SerialWrite write = serialPending.front();
+                bool link = serialPending.size() > 1;
+                if (!ring->prepWrite(serialFd, slot(write.index) + write.offset,
+                                     write.length,
+                                     tag(SERIAL_WRITE, write.index), link)) {
+                    break;
+                }
+                serialInFlight[write.index] = write;
+                serialPending.pop_front();
+                serialWrites++;
+            }
+        }
+
+        if (ring->submit(1) < 0 && errno != EINTR) {
+            SPDLOG_ERROR("io_uring_enter error({}) {}", errno,
+                         strerror(errno));
+            wait100ms();
+        }
+
+        ring->reap([&](uint64_t userData, int32_t result) {
+            size_t index = userData & UINT32_MAX;
+            char *frame = slot(index);
+            switch (userData >> 32) {
+            case TAP_READ:
+                if (result <= 0) {
+                    SPDLOG_ERROR("TAP read error({}) {}", -result,
+                                 strerror(-result));
+                    tapReadRetries.push_back(index);
+                    break;
+                }
+                // Length header in front of the data, see frame_write()
+                {
+                    uint16_t hdr = htons(result); // NOLINT
+                    memcpy(frame, &hdr, sizeof(hdr));
+                }
+                serialPending.push_back(
+                    {index, 0, sizeof(uint16_t) + static_cast<size_t>(result)});
+                break;
+            case SERIAL_WRITE: {
+                SerialWrite &write = serialInFlight[index];
+                serialWrites--;
+                // A short write severs the chain, the rest comes again
+                if (result == -ECANCELED ||
+                    (result >= 0 &&
+                     static_cast<size_t>(result) < write.length)) {
+                    size_t done = static_cast<size_t>(std::max(result, 0));
+                    serialResumed.push_back({write.index, write.offset + done,
+                                             write.length - done});
+                    break;
+                }
+                if (result < 0) {
+                    SPDLOG_ERROR("OutBound write error({}) {}", -result,
+                                 strerror(-result));
+                }
+                postTapRead(index);
+                break;
+            }
+            case SERIAL_READ:
+                serialReading = false;
+                if (result <= 0) {
+                    SPDLOG_ERROR("Serial read error({}) {}", -result,
+                                 strerror(-result));
+                    serialReadRetry = true;
+                    break;
+                }
+                reader.commit(static_cast<size_t>(result));
+                takeFrames();
+                if (drained) {
+                    postSerialRead();
+                }
+                break;
+            case TAP_WRITE:
+                if (result < 0) {
+                    SPDLOG_ERROR("InBound write error({}) {}", -result,
+                                 strerror(-result));
+                }
+                tapWriteSlots.push_back(index);
+                if (!drained) {
+                    takeFrames();
+                    if (drained && !serialReading) {
+                        postSerialRead();
+                    }
+                }
+                break;
+            default:
+                for (size_t retry : tapReadRetries) {
+                    postTapRead(retry);
+                }
+                tapReadRetries.clear();
+                if (serialReadRetry) {
+                    serialReadRetry = false;
+                    postSerialRead();
+                }
+                // Wake up to check io_is_enabled()
+                ring->prepTimeout(100, tag(TICK, 0));
+                break;
+            }
+        });
+
+        // In chain order, before the frames that were not written yet
+        serialPending.insert(serialPending.begin(), serialResumed.begin(),
+                             serialResumed.end());
+        serialResumed.clear();
+    }
+
+    SPDLOG_INFO("forwardUring thread stopped");
+}
+
+/**
+ * serialToTap(), tapToSerial(), readOutBound() and readInBound() on one
+ * thread. Every fd is non-blocking and watched by one epoll reactor, a frame
+ * the destination does not take at once waits in its write queue. Nothing
+ * sleeps: a thread only wakes up for I/O or a signal.
+ */
+template <typename Extension>
+void CommDevices<Extension>::runReactor()
+{
+    EpollReactor reactor;
+    if (!reactor.valid()) {
+        SPDLOG_ERROR("epoll_create1() error({}) {}", errno, strerror(errno));
+        return;
+    }
+
+    const int tapFd = this->tapFileDescriptor;
+    const int serialFd = this->serialFileDescriptor;
+
+    // Where the frames go, see writeInBound() and tapToSerial()
+    WriteQueue toTap(reactor, tapFd);
+    WriteQueue toSerial(reactor, serialFd);
+    std::unique_ptr<WriteQueue> toOuter;
+    std::unique_ptr<WriteQueue> toInner;
+    if (hasExtension()) {
+        toOuter = std::make_unique<WriteQueue>(
+            reactor, extensionFileno(ExtensionPoint::OUTER));
+        toInner = std::make_unique<WriteQueue>(
+            reactor, extensionFileno(ExtensionPoint::INNER));
+    }
+    WriteQueue &inBound = toOuter ? *toOuter : toTap;
+
+    std::vector<char> buffer(frameLength());
+    Buffer_t encoded(cobsFraming ? cobs_max_encoded_length(buffer.size())
+                                 : 0);
+
+    // Read one fd until EAGAIN or the budget is used up
+    auto drain = [&buffer](const char *name, auto &&readFn, auto &&onData) {
+        for (size_t i = 0; i < REACTOR_BUDGET; i++) {
+            ssize_t count = readFn(buffer.data(), buffer.size());
+            if (count > 0) {
+                onData(buffer.data(), static_cast<size_t>(count));
+                continue;
+            }
+            if (count == 0) {
+                SPDLOG_INFO("{} closed", name);
+                io_cancel();
+            } else if (errno != EAGAIN && errno != EINTR) {
+                SPDLOG_ERROR("{} read error({}) {}", name, errno,
+                             strerror(errno));
+            }
+            return;
+        }
+    };
+
+    // TAP -> serial port, or the extension
+    auto onTapReadable = [&]() {
+        drain(
+            "TAP",
+            [tapFd](char *buf, size_t len) { return read(tapFd, buf, len); },
+            [&](char *frame, size_t count) {
+                if (toInner) {
+                    (void)toInner->write(frame, count);
+                } else if (cobsFraming) {
+                    size_t encodedLength = 0;
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                    inBuffer_t data(reinterpret_cast<uint8_t *>(frame), count);
+                    if (cobs_encode(data, count, encoded, &encodedLength) ==
+                        SLIP_OK) {
+                        (void)toSerial.write(encoded.data(), encodedLength);
+                    }
+                } else {
+                    // One length header per piece, see frame_write_segmented()
+                    do {
+                        size_t piece =
+                            std::min<size_t>(count, ETHER_FRAME_LEN_MASK);
+                        uint16_t hdr = htons( // NOLINT
+                            piece | ((piece < count) ? ETHER_FRAME_MORE : 0));
+                        std::array<struct iovec, 2> iov = {
+                            {{&hdr, sizeof(hdr)}, {frame, piece}}};
+                        (void)toSerial.write(iov.data(), iov.size());
+                        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+                        frame += piece;
+                        count -= piece;
+                    } while (count > 0);
+                }
+            });
+    };
+
+    // Serial port -> TAP, or the extension. The bytes are parsed as a
+    // stream, a read may end anywhere in a frame
+    CobsDecoder cobsDecoder(offload ? frameLength() : ETHER_FRAME_LEN_MASK);
+    FrameReader frameReader(frameLength());
+    auto onSerialReadable = [&]() {
+        if (cobsFraming) {
+            drain(
+                "Serial",
+                [serialFd](char *buf, size_t len) {
+                    return read(serialFd, buf, len);
+                },
+                [&](char *data, size_t count) {
+                    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+                    inBuffer_t bytes(reinterpret_cast<uint8_t *>(data), count);
+                    cobsDecoder.feed(bytes, count,
+                                     [&](const inBuffer_t &frame) {
+                                         (void)inBound.write(frame.data(),
+                                                             frame.size());
+                                     });
+                });
+            return;
+        }
+
+        // The reader has its own buffer
+        drain(
+            "Serial",
+            [&](char * /*buf*/, size_t /*len*/) {
+                return frameReader.fill(serialFd);
+            },
+            [&](char * /*data*/, size_t /*count*/) {
+                const char *frame = nullptr;
+                size_t length = 0;
+                while (frameReader.next(&frame, &length)) {
+                    (void)inBound.write(frame, length);
+                }
+            });
+    };
+
+    bool watched = reactor.add(tapFd, onTapReadable, [&toTap] {
+        toTap.flush();
+    }) && reactor.add(serialFd, onSerialReadable, [&toSerial] {
+        toSerial.flush();
+    });
+
+    // Extension -> serial port, as readOutBound() does, and extension -> TAP,
+    // as readInBound() does. One readBatch() per wakeup takes the budget.
+    PacketBatch batch(frameLength(),
+                      hasExtension() ? REACTOR_BUDGET : 0);
+    auto drainBatch = [&](ExtensionPoint::Channel channel, WriteQueue &to) {
+        ssize_t packets = extensionReadBatch(channel, batch.reset());
+        if (packets == 0) {
+            SPDLOG_INFO("Extension closed");
+            io_cancel();
+        } else if (packets < 0 && errno != EAGAIN && errno != EINTR) {
+            SPDLOG_ERROR("Extension read error({}) {}", errno,
+                         strerror(errno));
+        }
+        for (ssize_t i = 0; i < packets; i++) {
+            (void)to.write(batch[i].buf, batch[i].count);
+        }
+    };
+    if (hasExtension()) {
+        watched = watched &&
+            reactor.add(
+                extensionFileno(ExtensionPoint::OUTER),
+                [&]() { drainBatch(ExtensionPoint::OUTER, toSerial); },
+                [&toOuter] { toOuter->flush(); }) &&
+            reactor.add(
+                extensionFileno(ExtensionPoint::INNER),
+                [&]() { drainBatch(ExtensionPoint::INNER, toTap); },
+                [&toInner] { toInner->flush(); });
+    }
+    if (!watched) {
+        SPDLOG_ERROR("epoll_ctl() error({}) {}", errno, strerror(errno));
+        return;
+    }
+
+    while (io_is_enabled()) {
+        // NOTE: a signal wakes us up with EINTR, the timeout only covers one
+        // that comes in before epoll_wait()
+        if (reactor.poll(1000) < 0 && errno != EINTR) {
+            SPDLOG_ERROR("epoll_wait() error({}) {}", errno, strerror(errno));
+            break;
+        }
+    }
+
+    if (toTap.dropped() + toSerial.dropped() > 0) {
+        SPDLOG_INFO("Frames dropped: TAP {}, serial {}", toTap.dropped(),
+                    toSerial.dropped());
+    }
+    SPDLOG_INFO("runReactor stopped");
+}
+
+namespace {
+
+/* A kernel pipe for splice(), large enough for the longest frame */
+class KernelPipe
+{
+public:
+    KernelPipe() { open(); }
+    ~KernelPipe() { close(); }
+
+    KernelPipe(const KernelPipe &) = delete;
+    KernelPipe &operator=(const KernelPipe &) = delete;
+    KernelPipe(KernelPipe &&) = delete;
+    KernelPipe &operator=(KernelPipe &&) = delete;
+
+    int readEnd() const { return fd[0]; }
+    int writeEnd() const { return fd[1]; }
+
+    /* Drop what is in the pipe, after an error */
+    void reset()
+    {
+        close();
+        open();
+    }
+
+private:
+    void open()
+    {
+#ifdef __linux__
+        if (pipe2(fd.data(), O_CLOEXEC) < 0) {
+            SPDLOG_ERROR("pipe2() error({}) {}", errno, strerror(errno));
+            return;
+        }
+        // A frame and its headers have to fit, TAP reads are not resumed
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        if (fcntl(fd[1], F_SETPIPE_SZ, 2 * CommConfig::frameLength()) < 0) {
+            SPDLOG_ERROR("F_SETPIPE_SZ error({}) {}", errno, strerror(errno));
+        }
+#endif
+    }
+
+    void close()
+    {
+        for (int &end : fd) {
+            if (end >= 0) {
+                ::close(end);
+                end = -1;
+            }
+        }
+    }
+
+    std::array<int, 2> fd{{-1, -1}};
+};
+
+#ifdef __linux__
+/**
+ * splice() exactly length bytes, waitFd is the end that is not a pipe
+ * @return length, less at end of file, or -1 with errno set
+ */
+ssize_t splice_n(int in, int out, size_t length, int waitFd, short events)
+{
+    size_t done = 0;
+    while (done < length && io_is_enabled()) {
+        ssize_t count =
+            splice(in, nullptr, out, nullptr, length - done, SPLICE_F_MOVE);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN && io_wait(waitFd, events) == 0) {
+                continue;
+            }
+            return -1;
+        }
+        if (count == 0) {
+            break;
+        }
+        done += static_cast<size_t>(count);
+    }
+    return static_cast<ssize_t>(done);
+}
+#endif
+
+} // namespace
+
+bool CommConfig::spliceCapable(int serialFd, int tapFd)
+{
+#ifdef __linux__
+    // splice() moves data between a pipe and the transport, frames need a
+    // byte stream
+    struct stat st = {};
+    if (fstat(serialFd, &st) < 0) {
+        return false;
+    }
+    int type = 0;
+    socklen_t typeLength = sizeof(type);
+    if (!S_ISFIFO(st.st_mode) &&
+        !(S_ISSOCK(st.st_mode) &&
+          getsockopt(serialFd, SOL_SOCKET, SO_TYPE, &type, &typeLength) ==
+              0 &&
+          type == SOCK_STREAM)) {
+        return false;
+    }
+
+    // tun lost splice_read and splice_write with Linux 5.10, both fail with
+    // EINVAL before they would wait. The write goes first, from the empty
+    // pipe; the read may take a byte of a waiting frame, which is dropped.
+    std::array<int, 2> pipeFds{{-1, -1}};
+    if (pipe2(pipeFds.data(), O_CLOEXEC) < 0) {
+        return false;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    int flags = fcntl(tapFd, F_GETFL);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    (void)fcntl(tapFd, F_SETFL, flags | O_NONBLOCK);
+    bool capable =
+        (splice(pipeFds[0], nullptr, tapFd, nullptr, 1, SPLICE_F_NONBLOCK) >=
+             0 ||
+         errno == EAGAIN) &&
+        (splice(tapFd, nullptr, pipeFds[1], nullptr, 1, SPLICE_F_NONBLOCK) >=
+             0 ||
+         errno == EAGAIN);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    (void)fcntl(tapFd, F_SETFL, flags);
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    return capable;
 #else
+    (void)serialFd;
+    (void)tapFd;
+    return false;
+#endif
+}
+
+/**
+ * tapToSerial() without copies: the TAP frame is spliced into a pipe, its
+ * length header is written into a second pipe in front of it, and the
+ * second pipe is spliced to the serial port.
+ * @return false if the TAP cannot be spliced, nothing is lost then
+ */
+template <typename Extension>
+bool CommDevices<Extension>::tapToSerialSplice()
+{
+#ifdef __linux__
+    const int tapFd = this->tapFileDescriptor;
+    const int serialFd = this->serialFileDescriptor;
+
+    KernelPipe payload;
+    KernelPipe framed;
+    bool first = true;
+
+    while (io_is_enabled()) {
+        ssize_t count = splice(tapFd, nullptr, payload.writeEnd(), nullptr,
+                               frameLength(), SPLICE_F_MOVE);
+        if (count < 0 && errno == EINVAL && first) {
+            SPDLOG_INFO("TAP splice not supported, copying");
+            return false;
+        }
+        if (count < 0 && errno == EAGAIN) {
+            (void)io_wait(tapFd, POLLIN);
             continue;
+        }
+        if (count <= 0) {
+            SPDLOG_ERROR("TAP splice error({}) {}", errno, strerror(errno));
+            wait100ms();
+            continue;
+        }
+        first = false;
+
+        // One length header per piece, see frame_write_segmented()
+        size_t left = static_cast<size_t>(count);
+        size_t total = 0;
+        bool moved = true;
+        while (moved && left > 0) {
+            size_t piece = std::min<size_t>(left, ETHER_FRAME_LEN_MASK);
+            uint16_t hdr = htons( // NOLINT
+                piece | ((piece < left) ? ETHER_FRAME_MORE : 0));
+            moved = write(framed.writeEnd(), &hdr, sizeof(hdr)) ==
+                    sizeof(hdr) &&
+                splice_n(payload.readEnd(), framed.writeEnd(), piece,
+                         framed.writeEnd(), POLLOUT) ==
+                    static_cast<ssize_t>(piece);
+            left -= piece;
+            total += sizeof(hdr) + piece;
+        }
+
+        ssize_t serialResult = -1;
+        if (moved) {
+            std::lock_guard<std::mutex> lock(serialWriteMutex);
+            serialResult = splice_n(framed.readEnd(), serialFd, total,
+                                    serialFd, POLLOUT);
+        }
+        if (serialResult != static_cast<ssize_t>(total)) {
+            SPDLOG_ERROR("OutBound splice error({}) {}", errno,
+                         strerror(errno));
+            payload.reset();
+            framed.reset();
+            wait100ms();
+        }
+    }
+
+    SPDLOG_INFO("tapToSerial thread stopped");
+    return true;
+#else
+    return false;
 #endif
+}
+
+/**
+ * serialToTap() without copies of the payload: only the length header is
+ * read, the payload is spliced into a pipe and from there to the TAP.
+ * @return false if the TAP cannot be spliced, after the first frame is
+ *         written with a copy
+ */
+template <typename Extension>
+bool CommDevices<Extension>::serialToTapSplice()
+{
+#ifdef __linux__
+    const int tapFd = this->tapFileDescriptor;
+    const int serialFd = this->serialFileDescriptor;
+
+    KernelPipe payload;
+    bool first = true;
+
+    while (io_is_enabled()) {
+        // Collect the pieces of a super-frame in the pipe
+        size_t total = 0;
+        uint16_t hdr = ETHER_FRAME_MORE;
+        ssize_t result = 0;
+        while ((hdr & ETHER_FRAME_MORE) != 0) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            result = read_n(serialFd, reinterpret_cast<char *>(&hdr),
+                            sizeof(hdr));
+            if (result != sizeof(hdr)) {
+                break;
+            }
+            hdr = ntohs(hdr); // NOLINT
+            size_t flen = hdr & ETHER_FRAME_LEN_MASK;
+            if (total + flen > frameLength()) {
+                errno = EMSGSIZE;
+                result = -1;
+                break;
+            }
+            result = splice_n(serialFd, payload.writeEnd(), flen, serialFd,
+                              POLLIN);
+            if (result != static_cast<ssize_t>(flen)) {
+                break;
+            }
+            total += flen;
+        }
+        if (!io_is_enabled()) {
+            break;
         }
+        if ((hdr & ETHER_FRAME_MORE) != 0 || result < 0) {
+            SPDLOG_ERROR("Serial splice error({}) {}", errno, strerror(errno));
+            payload.reset();
+            wait100ms();
+            continue;
+        }
+        if (total == 0) {
+            continue;
+        }
+
+        // One write to the TAP per frame
+        result = splice_n(payload.readEnd(), tapFd, total, tapFd, POLLOUT);
+        if (result < 0 && errno == EINVAL && first) {
+            // The frame is still in the pipe, the stream is at a frame start
+            SPDLOG_INFO("TAP splice not supported, copying");
+            std::vector<char> frame(total);
+            if (read_n(payload.readEnd(), frame.data(), total) ==
+                static_cast<int>(total)) {
+                (void)writeInBound(frame.data(), static_cast<ssize_t>(total));
+            }
+            return false;
+        }
+        if (result != static_cast<ssize_t>(total)) {
+            SPDLOG_ERROR("InBound splice error({}) {}", errno,
+                         strerror(errno));
+            payload.reset();
+            wait100ms();
+        }
+        first = false;
+    }
+
+    SPDLOG_INFO("serialToTap thread stopped");
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * tapToSerial() to an extension without a packet pool: the frames waiting
+ * on the TAP are read into a batch and written with one writeBatch()
+ */
+template <typename Extension>
+void CommDevices<Extension>::tapToExtension()
+{
+    const int tapFd = this->tapFileDescriptor;
+    PacketBatch batch(frameLength());
 
-        // Write the packet to the virtual interface
-        ssize_t count;
-        if (extensionPoint.get() != nullptr) {
-            count = extensionPoint->write(ExtensionPoint::OUTER,
-                                          inBuffer.data(), serialResult);
-        } else {
-            count = write(tapFd, inBuffer.data(), serialResult);
+    while (io_is_enabled()) {
+        // Wait for the first frame
+        gsl::span<ExtensionPoint::Packet> packets = batch.reset();
+        ssize_t count = read(tapFd, packets[0].buf, packets[0].count);
+        if (count < 0 && errno == EAGAIN) {
+            (void)io_wait(tapFd, POLLIN);
+            continue;
         }
-        if (count != serialResult) {
-            SPDLOG_ERROR("InBound write error({}) {}", errno, strerror(errno));
+        if (count <= 0) {
+            SPDLOG_ERROR("TAP read error({}) {}", errno, strerror(errno));
             wait100ms();
             continue;
         }
+        packets[0].count = static_cast<size_t>(count);
 
-#ifndef NDEBUG
-        if (extensionPoint.get() == nullptr) {
-            SPDLOG_TRACE(" serialToTap {}:{:n}", count,
-                         spdlog::to_hex(std::begin(inBuffer),
-                                        std::begin(inBuffer) + count));
+        // Take the others that are there
+        size_t frames = 1;
+        struct pollfd pfd = {tapFd, POLLIN, 0};
+        while (frames < packets.size() && poll(&pfd, 1, 0) > 0) {
+            count = read(tapFd, packets[frames].buf, packets[frames].count);
+            if (count <= 0) {
+                break;
+            }
+            packets[frames++].count = static_cast<size_t>(count);
+        }
+
+        ssize_t written =
+            extensionWriteBatch(ExtensionPoint::INNER, batch.first(frames));
+        if (written != static_cast<ssize_t>(frames)) {
+            SPDLOG_ERROR("OutBound write error({}) {}, {} packets dropped",
+                         errno, strerror(errno),
+                         frames - std::max<ssize_t>(written, 0));
             wait100ms();
         }
-#endif
     }
 
-    SPDLOG_INFO("serialToTap thread stopped");
+    SPDLOG_INFO("tapToSerial thread stopped");
 }
 
 /**
  * Handles getting packets from the TAP interface and writing them to the serial
  * port
  */
-void CommDevices::tapToSerial()
+template <typename Extension>
+void CommDevices<Extension>::tapToSerial()
 {
+    if (splicePassthrough && tapToSerialSplice()) {
+        return;
+    }
+    if (hasExtension() && !packetPool) {
+        tapToExtension();
+        return;
+    }
+
     // Grab thread parameters
     const int tapFd = this->tapFileDescriptor;
     const int serialFd = this->serialFileDescriptor;
 
     // Create TAP buffer
-    std::array<char, ETHER_FRAME_LENGTH> inBuffer{};
+    std::vector<char> inBuffer(frameLength());
+    Buffer_t outBuffer(cobsFraming ? cobs_max_encoded_length(inBuffer.size())
+                                   : 0);
+
+    // Packs the length header frames, see FrameReader for the other end
+    std::unique_ptr<FrameWriter> writer;
+    if (batchSize > 0 && !cobsFraming && !hasExtension() &&
+        this->mode != VTUN_PIPE) {
+        writer = std::make_unique<FrameWriter>(serialFd, batchSize, batchDelay,
+                                               &serialWriteMutex);
+    }
 
     while (io_is_enabled()) {
+        // Write the collected frames if no more come in time
+        if (writer && !writer->waitReadable(tapFd)) {
+            continue;
+        }
+
+        // A packet for the extension is read into the buffer handed on,
+        // the copy into inBuffer is left if the pool is used up
+        PacketRef packet;
+        if (hasExtension() && packetPool) {
+            packet = packetPool->allocate();
+        }
+        char *frame = packet ? packet.data() : inBuffer.data();
+        size_t room = packet ? packet.capacity() : inBuffer.size();
+
         // Incoming byte count
-        ssize_t count = read(tapFd, inBuffer.data(), inBuffer.size());
+        ssize_t count = read(tapFd, frame, room);
+        if (count < 0 && errno == EAGAIN) {
+            (void)io_wait(tapFd, POLLIN);
+            continue;
+        }
         if (count <= 0) {
             SPDLOG_ERROR("TAP read error({}) {}", errno, strerror(errno));
             wait100ms();
             continue;
         }
 
-        // Write to serial port
+        // Write to serial port, one frame at a time
+        std::unique_lock<std::mutex> lock(serialWriteMutex, std::defer_lock);
+        if (!writer) {
+            lock.lock();
+        }
         ssize_t serialResult;
-        if (extensionPoint.get() != nullptr) {
-            serialResult = extensionPoint->write(ExtensionPoint::INNER,
-                                                 inBuffer.data(), count);
+        if (writer) {
+            // The writer takes the lock for the transfer
+            serialResult = writer->write(inBuffer.data(), count);
+        } else if (packet) {
+            packet.setLength(static_cast<size_t>(count));
+            serialResult =
+                extensionWritePacket(ExtensionPoint::INNER, std::move(packet))
+                ? count
+                : -1;
+        } else if (hasExtension()) {
+            serialResult = extensionWrite(ExtensionPoint::INNER, frame, count);
 #ifndef NDEBUG
         } else if (this->mode == VTUN_PIPE) {
             // selftest only:
             serialResult = pipe_write(serialFd, inBuffer.data(), count);
 #endif
 
+        } else if (cobsFraming) {
+            size_t encodedLength = 0;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            inBuffer_t frame(reinterpret_cast<uint8_t *>(inBuffer.data()),
+                             count);
+            if (cobs_encode(frame, count, outBuffer, &encodedLength) !=
+                SLIP_OK) {
+                continue;
+            }
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+            serialResult = write_n(serialFd,
+                                   reinterpret_cast<char *>(outBuffer.data()),
+                                   encodedLength);
         } else {
-            serialResult = frame_write(serialFd, inBuffer.data(), count);
+            serialResult =
+                frame_write_segmented(serialFd, inBuffer.data(), count);
+        }
+        if (lock.owns_lock()) {
+            lock.unlock();
         }
         if (serialResult < 0) {
             SPDLOG_ERROR("OutBound write error({}) {}", errno, strerror(errno));
@@ -156,7 +1209,7 @@ void CommDevices::tapToSerial()
         }
 
 #ifndef NDEBUG
-        if (extensionPoint.get() == nullptr) {
+        if (!hasExtension()) {
             SPDLOG_TRACE(" tapToSerial {}:{:n}", count,
                          spdlog::to_hex(std::begin(inBuffer),
                                         std::begin(inBuffer) + count));
@@ -165,94 +1218,387 @@ void CommDevices::tapToSerial()
 #endif
     }
 
+    if (writer) {
+        (void)writer->flush();
+        SPDLOG_INFO("tapToSerial {} frames in {} transfers", writer->frames(),
+                    writer->transfers());
+    }
     SPDLOG_INFO("tapToSerial thread stopped");
 }
 
-void CommDevices::readOutBound()
+template <typename Extension>
+void CommDevices<Extension>::readOutBound()
 {
     // Grab thread parameters
-    if (extensionPoint.get() == nullptr)
+    if (!hasExtension())
         return;
 
-    // Create outgoing buffer
-    std::array<char, ETHER_FRAME_LENGTH> inBuffer{};
+    // Create outgoing buffers, not needed with a pool
+    PacketBatch batch(packetPool ? 0 : frameLength());
 
     while (io_is_enabled()) {
-        // Read outgoing byte count
-        ssize_t result = extensionPoint->read(ExtensionPoint::OUTER,
-                                              inBuffer.data(), inBuffer.size());
-        if (result <= 0) {
-            SPDLOG_ERROR("OutBound: read error({}) {}", errno, strerror(errno));
-            wait100ms();
+        // A pool buffer is written where tapToSerial() read it into
+        if (packetPool) {
+            PacketRef packet = extensionReadPacket(ExtensionPoint::OUTER);
+            if (!packet) {
+                SPDLOG_ERROR("OutBound: read error({}) {}", errno,
+                             strerror(errno));
+                wait100ms();
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(serialWriteMutex);
+            (void)serialWritePacket(packet.data(), packet.length());
             continue;
         }
 
-        // Write the packet to the serial interface
-        ssize_t count = write(serialFileDescriptor, inBuffer.data(), result);
-        if (count != result) {
-            SPDLOG_ERROR("Serial write error({}) {}", errno, strerror(errno));
+        // Read the outgoing packets waiting
+        ssize_t packets =
+            extensionReadBatch(ExtensionPoint::OUTER, batch.reset());
+        if (packets <= 0) {
+            SPDLOG_ERROR("OutBound: read error({}) {}", errno, strerror(errno));
             wait100ms();
             continue;
         }
 
-#ifndef NDEBUG
-        SPDLOG_TRACE(
-            "readOutBound {}:{:n}", count,
-            spdlog::to_hex(std::begin(inBuffer), std::begin(inBuffer) + count));
-        wait100ms();
-#endif
+        // Write the packets to the serial interface, one lock per batch
+        std::lock_guard<std::mutex> lock(serialWriteMutex);
+        for (ssize_t i = 0; i < packets; i++) {
+            if (!serialWritePacket(batch[i].buf, batch[i].count)) {
+                break;
+            }
+        }
     }
 
     SPDLOG_INFO("readOutBound thread stopped");
 }
 
-void CommDevices::readInBound()
+/**
+ * Write one packet from the extension to the serial port, the caller holds
+ * serialWriteMutex
+ * @return false on error
+ */
+template <typename Extension>
+bool CommDevices<Extension>::serialWritePacket(const void *buf, size_t count)
+{
+    ssize_t result = write(serialFileDescriptor, buf, count);
+    if (result != static_cast<ssize_t>(count)) {
+        SPDLOG_ERROR("Serial write error({}) {}", errno, strerror(errno));
+        return false;
+    }
+
+#ifndef NDEBUG
+    const char *data = static_cast<const char *>(buf);
+    SPDLOG_TRACE("readOutBound {}:{:n}", result,
+                 spdlog::to_hex(data, data + result));
+#endif
+    return true;
+}
+
+template <typename Extension>
+void CommDevices<Extension>::readInBound()
 {
     // Grab thread parameters
-    if (extensionPoint.get() == nullptr)
+    if (!hasExtension())
         return;
 
-    // Create incomming buffer
-    std::array<char, ETHER_FRAME_LENGTH> inBuffer{};
+    // Create incomming buffers, not needed with a pool
+    PacketBatch batch(packetPool ? 0 : frameLength());
 
     while (io_is_enabled()) {
-        // read incomming byte count
-        ssize_t count = extensionPoint->read(ExtensionPoint::INNER,
-                                             inBuffer.data(), inBuffer.size());
-        if (count <= 0) {
-            SPDLOG_ERROR("InBound: read error({}) {}", errno, strerror(errno));
-            wait100ms();
+        // A pool buffer is written to the TAP where the extension left it
+        if (packetPool) {
+            PacketRef packet = extensionReadPacket(ExtensionPoint::INNER);
+            if (!packet) {
+                SPDLOG_ERROR("InBound: read error({}) {}", errno,
+                             strerror(errno));
+                wait100ms();
+                continue;
+            }
+            (void)tapWritePacket(packet.data(), packet.length());
             continue;
         }
 
-        // Write outgoing packet
-        ssize_t result = write(tapFileDescriptor, inBuffer.data(), count);
-        if (result < 0) {
-            SPDLOG_ERROR("readInBound: write error({}) {}", errno,
-                         strerror(errno));
+        // read the incomming packets waiting
+        ssize_t packets =
+            extensionReadBatch(ExtensionPoint::INNER, batch.reset());
+        if (packets <= 0) {
+            SPDLOG_ERROR("InBound: read error({}) {}", errno, strerror(errno));
             wait100ms();
             continue;
         }
 
-#ifndef NDEBUG
-        SPDLOG_TRACE(
-            " readInBound {}:{:n}", count,
-            spdlog::to_hex(std::begin(inBuffer), std::begin(inBuffer) + count));
+        // Write outgoing packets, the TAP takes one per write()
+        for (ssize_t i = 0; i < packets; i++) {
+            if (!tapWritePacket(batch[i].buf, batch[i].count)) {
+                break;
+            }
+        }
+    }
+
+    SPDLOG_INFO("readInBound thread stopped");
+}
+
+/**
+ * Write one packet from the extension to the TAP interface
+ * @return false on error
+ */
+template <typename Extension>
+bool CommDevices<Extension>::tapWritePacket(const void *buf, size_t count)
+{
+    ssize_t result = write(tapFileDescriptor, buf, count);
+    if (result < 0) {
+        SPDLOG_ERROR("readInBound: write error({}) {}", errno,
+                     strerror(errno));
         wait100ms();
+        return false;
+    }
+
+#ifndef NDEBUG
+    const char *data = static_cast<const char *>(buf);
+    SPDLOG_TRACE(" readInBound {}:{:n}", result,
+                 spdlog::to_hex(data, data + result));
 #endif
+    return true;
+}
+
+/**
+ * Hand the fds to a new instance when it connects to path, see Handoff.h.
+ * Returns after io_cancel(), the process exits after a handoff.
+ */
+static void serve_handoff(const char *path, const std::vector<int> &tapFds,
+                          int serialFd)
+{
+    int listenFd = handoff_listen(path);
+    if (listenFd < 0) {
+        SPDLOG_ERROR("handoff_listen() error({}) {}", errno, strerror(errno));
+        return;
     }
 
-    SPDLOG_INFO("readInBound thread stopped");
+    std::vector<int> fds{serialFd};
+    fds.insert(fds.end(), tapFds.begin(), tapFds.end());
+    while (io_is_enabled()) {
+        struct pollfd pfd = {listenFd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) <= 0) {
+            continue;
+        }
+
+        struct handoff_state state = {};
+        state.flags = CommConfig::offload ? HANDOFF_OFFLOAD : 0;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+        strncpy(state.adapterName, adapterName, IF_NAMESIZE - 1);
+
+        // The adapter has to survive if the new instance dies before it
+        // acknowledged the fds
+        int persistent = tun_set_persist(tapFds[0], true);
+        if (persistent == 0) {
+            state.flags |= HANDOFF_PERSIST_SET;
+        }
+        if (handoff_give(listenFd, &state, fds.data(), fds.size(), 1000) ==
+            0) {
+            SPDLOG_INFO("Handed {} over to the new instance", adapterName);
+            // NOTE: the threads may block in read(), they end with us
+            _exit(EXIT_SUCCESS);
+        }
+
+        SPDLOG_ERROR("handoff_give() error({}) {}", errno, strerror(errno));
+        if (persistent == 0) {
+            (void)tun_set_persist(tapFds[0], false);
+        }
+    }
+
+    close(listenFd);
+    unlink(path);
+}
+
+/* What main() set up for the engines */
+struct Engines
+{
+    std::vector<int> tapFds; // one per TAP queue
+    int serialFd;
+    enum tun_mode_t mode;
+    IoUring *ring;           // the io_uring engine, or nullptr
+    bool reactor;            // the epoll engine
+    bool nonBlocking;        // the threads wait for readiness
+    const char *handoffPath; // wait for a new instance, or nullptr
+};
+
+/**
+ * Run the engines with the given extension type until io_cancel(), see
+ * CommDevices
+ * @return exit code, the fds are closed
+ */
+template <typename Extension>
+static int run_engines(const Engines &engines,
+                       std::shared_ptr<Extension> extension)
+{
+    typedef CommDevices<Extension> devices_t;
+    const std::vector<int> &tapFds = engines.tapFds;
+    const int tapFd = tapFds[0];
+    const int serialFd = engines.serialFd;
+    const enum tun_mode_t mode = engines.mode;
+    IoUring *ring = engines.ring;
+    const bool reactor = engines.reactor;
+
+    devices_t threadParams(tapFd, serialFd, mode, extension);
+
+    // Everything on this thread, signals interrupt epoll_wait()
+    if (reactor && engines.handoffPath == nullptr) {
+        threadParams.runReactor();
+        close(tapFd);
+        close(serialFd);
+        return EXIT_SUCCESS;
+    }
+
+    // Create threads, one reader per TAP queue or one for io_uring. They
+    // are joined, so they share their parameters instead of a copy each.
+    std::deque<devices_t> queueParams;
+    std::vector<std::thread> tap2serial;
+    std::thread serial2tap;
+    if (ring != nullptr) {
+        tap2serial.emplace_back(&devices_t::forwardUring, &threadParams,
+                                ring);
+    } else if (reactor) {
+        // This thread waits for a new instance
+        tap2serial.emplace_back(&devices_t::runReactor, &threadParams);
+    }
+    for (size_t i = 0; ring == nullptr && !reactor && i < tapFds.size();
+         i++) {
+        queueParams.emplace_back(tapFds[i], serialFd, mode, extension);
+        tap2serial.emplace_back(&devices_t::tapToSerial, &queueParams.back());
+        if (tapFds.size() > 1) {
+            (void)pin_thread(tap2serial.back().native_handle(), i);
+        }
+    }
+    if (ring == nullptr && !reactor) {
+        serial2tap = std::thread(&devices_t::serialToTap, &threadParams);
+    }
+
+    // NOTE: selftest only:
+    // The detached threads may outlive us, they get a copy. The reactor
+    // drains the extension itself.
+    if (!reactor && (extension || (mode == VTUN_PIPE))) {
+        std::thread outBound(&devices_t::readOutBound, threadParams);
+        outBound.detach();
+        std::thread inBound(&devices_t::readInBound, threadParams);
+        inBound.detach();
+    }
+
+    // NOTE: selftest only:
+    if (mode == VTUN_PIPE) {
+        alarm(4); // NOTE: XXX watchdog timer: send unhandled SIGALRM after
+                  // 4 sec! CK
+        char msg[] = "Hallo\n";
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+        (void)write_n(1, msg, sizeof(msg)); // stdout
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+        if (readn_t(0, msg, sizeof(msg), 3) < 0) {
+            SPDLOG_INFO("Timeout while read from stdin");
+        } else {
+            sleep(1);
+        }
+
+        shutdown(serialFd, SHUT_WR);
+        shutdown(tapFd, SHUT_WR);
+        extension.reset();
+    }
+
+    if (engines.handoffPath != nullptr && mode != VTUN_PIPE) {
+        serve_handoff(engines.handoffPath, tapFds, serialFd);
+    }
+
+    for (auto &thread : tap2serial) {
+        thread.join();
+    }
+    SPDLOG_INFO("Thread tapToSerial joined ");
+    for (int queueFd : tapFds) {
+        close(queueFd);
+    }
+
+    if (serial2tap.joinable()) {
+        serial2tap.join();
+        SPDLOG_INFO("Thread serialToTap joined ");
+    }
+    close(serialFd);
+
+    if (engines.nonBlocking) {
+        struct io_wait_stats stats = io_get_wait_stats();
+        SPDLOG_INFO("I/O retries {}, waits {}, timeouts {}", stats.retries,
+                    stats.waits, stats.timeouts);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* Copy the packets of one channel of the RED peer to the other one */
+static void red_forward(ShmPipe &pipe, ExtensionPoint::Channel from,
+                        ExtensionPoint::Channel to)
+{
+    PacketBatch batch(pipe.packetLength());
+    while (io_is_enabled()) {
+        ssize_t packets = pipe.readBatch(from, batch.reset());
+        if (packets < 0 && (errno == ECANCELED || errno == EPIPE)) {
+            break;
+        }
+        if (packets <= 0) {
+            SPDLOG_ERROR("RED read error({}) {}", errno, strerror(errno));
+            CommConfig::wait100ms();
+            continue;
+        }
+
+        ssize_t written =
+            pipe.writeBatch(to, batch.first(static_cast<size_t>(packets)));
+        if (written < 0 && (errno == ECANCELED || errno == EPIPE)) {
+            break;
+        }
+        if (written != packets) {
+            SPDLOG_ERROR("RED write error({}) {}", errno, strerror(errno));
+        }
+    }
+}
+
+/**
+ * The RED process of a simpletap started with -x path: attach to its shared
+ * rings and pass the packets on between the channels, what Pipe does in
+ * process. Runs until the host is gone or a signal.
+ */
+static int run_red_peer(const char *path)
+{
+    std::unique_ptr<ShmPipe> pipe = ShmPipe::attach(path);
+    if (!pipe) {
+        SPDLOG_ERROR("ShmPipe::attach() error({}) {}", errno, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    SPDLOG_INFO("RED process attached to {}", path);
+
+    std::thread inBound(red_forward, std::ref(*pipe), ExtensionPoint::OUTER,
+                        ExtensionPoint::INNER);
+    red_forward(*pipe, ExtensionPoint::INNER, ExtensionPoint::OUTER);
+    // The other direction stops too, its read fails the same way
+    io_cancel();
+    inBound.join();
+
+    SPDLOG_INFO("RED process stopped");
+    return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[])
 {
     enum tun_mode_t mode = VTUN_ETHER;
     bool red_node = false;
+    size_t queues = 1;
+    size_t chainStages = 1;
+    bool uring = false;
+    bool reactor = false;
+    bool nonBlocking = false;
+    int waitTimeoutMs = -1;
+    const char *handoffPath = nullptr;
+    const char *shmPath = nullptr;
+    const char *peerPath = nullptr;
+    bool hugePages = false;
 
     // Grab parameters
     int param;
-    while ((param = getopt(argc, argv, "i:d:prv")) > 0) {
+    while ((param = getopt(argc, argv, "i:d:f:q:m:t:b:w:H:x:X:c:gnoprsv")) > 0) {
         switch (param) {
         case 'i':
             // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
@@ -263,6 +1609,77 @@ int main(int argc, char *argv[])
             strncpy(static_cast<char *>(serialDevice), optarg,
                     sizeof(serialDevice) - 1);
             break;
+        case 'f':
+            if (strcmp(optarg, "cobs") == 0) {
+                CommConfig::cobsFraming = true;
+            } else if (strcmp(optarg, "len") != 0) {
+                std::cerr << "Unknown framing " << optarg << " (len|cobs)"
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'q':
+            queues = strtoul(optarg, NULL, 10);
+            if (queues == 0) {
+                std::cerr << "Queue count must be at least 1" << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm':
+            if (strcmp(optarg, "uring") == 0) {
+                uring = true;
+            } else if (strcmp(optarg, "epoll") == 0) {
+                reactor = true;
+            } else if (strcmp(optarg, "threads") != 0) {
+                std::cerr << "Unknown I/O engine " << optarg
+                          << " (threads|uring|epoll)" << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            nonBlocking = true;
+            break;
+        case 't':
+            waitTimeoutMs = static_cast<int>(strtol(optarg, NULL, 10));
+            break;
+        case 'b':
+            CommConfig::batchSize = strtoul(optarg, NULL, 10);
+            if (CommConfig::batchSize > FrameReader::MAX_TRANSFER) {
+                std::cerr << "Batch size must be at most "
+                          << FrameReader::MAX_TRANSFER << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'w':
+            CommConfig::batchDelay =
+                std::chrono::microseconds(strtol(optarg, NULL, 10));
+            break;
+        case 's':
+            CommConfig::splicePassthrough = true;
+            break;
+        case 'H':
+            handoffPath = optarg;
+            break;
+        case 'x':
+            shmPath = optarg;
+            red_node = true;
+            break;
+        case 'X':
+            peerPath = optarg;
+            break;
+        case 'c':
+            chainStages = strtoul(optarg, NULL, 10);
+            if (chainStages == 0) {
+                std::cerr << "Stage count must be at least 1" << std::endl;
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'g':
+            hugePages = true;
+            break;
+        case 'o':
+            CommConfig::offload = true;
+            break;
         case 'r':
             red_node = true;
             break;
@@ -274,16 +1691,44 @@ int main(int argc, char *argv[])
             break;
         default:
             std::cerr << "Usage: " << *argv
-                      << "s -i tun0 -d /dev/spidip2.0 [-r] [-p] [-v]"
-                      << std::endl;
+                      << "s -i tun0 -d /dev/spidip2.0 [-f len|cobs] [-q N]"
+                      << " [-m threads|uring|epoll] [-n [-t ms]]"
+                      << " [-b bytes [-w us]] [-s] [-H path] [-o]"
+                      << " [-r [-c N] [-g] | -x path] [-p] [-v]" << std::endl
+                      << "       " << *argv << " -X path [-v]" << std::endl;
             return EXIT_FAILURE;
         }
     }
 
+    // register signal handler
+    struct sigaction sa = {};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
+    sa.sa_handler = signal_handler;
+    sigaction(SIGHUP, &sa, NULL);  // terminal line hangup (1)
+    sigaction(SIGQUIT, &sa, NULL); // quit program (3)
+    sigaction(SIGPIPE, &sa,
+              NULL); // Broken pipe: write to pipe with no readers (13)
+    // NO!   sigaction(SIGALRM, &sa, NULL); // XXX timer expired (14)
+    // FIXME sigaction(SIGTERM, &sa, NULL); // software termination signal (15)
+
+    // The RED process of another simpletap, no devices of its own
+    if (peerPath != nullptr) {
+        return run_red_peer(peerPath);
+    }
+
     if (serialDevice[0] == '\0') {
         std::cerr << "Serial port required (-d /dev/name)" << std::endl;
         return EXIT_FAILURE;
     }
+    if (shmPath != nullptr && queues > 1) {
+        std::cerr << "Shared rings take one writer (-x without -q)"
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+    if ((chainStages > 1 || hugePages) && (!red_node || shmPath != nullptr)) {
+        std::cerr << "-c and -g need -r, not -x" << std::endl;
+        return EXIT_FAILURE;
+    }
 
     // NOTE: selftest only:
     int fd[2] = {-1, -1};
@@ -295,28 +1740,66 @@ int main(int argc, char *argv[])
         }
     }
 
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-    int tapFd = tun_open_common(adapterName, mode);
-    if (tapFd < 0) {
-        SPDLOG_ERROR("tun_open_common() error({}) {}", errno, strerror(errno));
-        if (mode != VTUN_PIPE) {
-            return EXIT_FAILURE;
+    // Take over the open devices of a running instance, the adapter keeps
+    // its addresses and routes
+    std::vector<int> tapFds;
+    int serialFd = -1;
+    if (handoffPath != nullptr && mode != VTUN_PIPE) {
+        struct handoff_state state = {};
+        std::array<int, HANDOFF_MAX_FDS> fds{};
+        int sock = -1;
+        int count = handoff_take(handoffPath, &sock, &state, fds.data(),
+                                 fds.size());
+        if (count < 0) {
+            SPDLOG_ERROR("handoff_take() error({}) {}", errno,
+                         strerror(errno));
+        } else if (count > 1) {
+            serialFd = fds[0];
+            tapFds.assign(fds.begin() + 1, fds.begin() + count);
+            CommConfig::offload = (state.flags & HANDOFF_OFFLOAD) != 0;
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+            strncpy(adapterName, state.adapterName, IF_NAMESIZE - 1);
+            if ((state.flags & HANDOFF_PERSIST_SET) != 0) {
+                (void)tun_set_persist(tapFds[0], false);
+            }
+            (void)handoff_ack(sock);
+            SPDLOG_INFO("Took over {} with {} queues", adapterName,
+                        tapFds.size());
         }
+    }
 
-        // NOTE: selftest only:
-        SPDLOG_INFO("Test mode, use VTUN_PIPE first end!");
-        tapFd = fd[0];
-        char pingMsg[] = "\x05\0TapPing";
+    // One fd per TAP queue, the first one is also used for writes
+    if (tapFds.empty()) {
+        tapFds.assign(queues, -1);
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-        (void)write_n(tapFd, pingMsg, sizeof(pingMsg));
+        if (tun_open_queues(adapterName, mode, tapFds.data(), queues,
+                            CommConfig::offload) < 0) {
+            SPDLOG_ERROR("tun_open_queues() error({}) {}", errno,
+                         strerror(errno));
+            if (mode != VTUN_PIPE) {
+                return EXIT_FAILURE;
+            }
+
+            // NOTE: selftest only:
+            SPDLOG_INFO("Test mode, use VTUN_PIPE first end!");
+            tapFds.assign(1, fd[0]);
+            char pingMsg[] = "\x05\0TapPing";
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+            (void)write_n(tapFds[0], pingMsg, sizeof(pingMsg));
+        }
     }
 
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
-    int serialFd = open(static_cast<char *>(serialDevice), O_RDWR | O_CLOEXEC);
+    if (serialFd < 0) {
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        serialFd =
+            open(static_cast<char *>(serialDevice), O_RDWR | O_CLOEXEC);
+    }
     if (serialFd < 0) {
         SPDLOG_ERROR("open() error({}) {}", errno, strerror(errno));
         if (mode != VTUN_PIPE) {
-            close(tapFd);
+            for (int queueFd : tapFds) {
+                close(queueFd);
+            }
             return EXIT_FAILURE;
         }
 
@@ -328,74 +1811,127 @@ int main(int argc, char *argv[])
         (void)frame_write(serialFd, pingMsg, sizeof(pingMsg));
     }
 
-    // register signal handler
-    struct sigaction sa = {};
-    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
-    sa.sa_handler = signal_handler;
-    sigaction(SIGHUP, &sa, NULL);  // terminal line hangup (1)
-    sigaction(SIGQUIT, &sa, NULL); // quit program (3)
-    sigaction(SIGPIPE, &sa,
-              NULL); // Broken pipe: write to pipe with no readers (13)
-    // NO!   sigaction(SIGALRM, &sa, NULL); // XXX timer expired (14)
-    // FIXME sigaction(SIGTERM, &sa, NULL); // software termination signal (15)
+    // The io_uring engine covers the plain length header path only
+    std::unique_ptr<IoUring> ring;
+    if (uring) {
+        if (CommConfig::cobsFraming || CommConfig::offload ||
+            tapFds.size() > 1 || red_node || mode == VTUN_PIPE) {
+            SPDLOG_INFO("io_uring needs -f len without -o, -q, -r or -p,"
+                        " using threads");
+        } else {
+            ring = std::make_unique<IoUring>(64);
+            if (!ring->valid()) {
+                SPDLOG_INFO("io_uring not available ({}), using threads",
+                            strerror(errno));
+                ring.reset();
+            }
+        }
+    }
+
+    // The reactor drives one TAP queue, the selftest needs the threads and
+    // the shared rings have no fd to poll
+    if (reactor &&
+        (tapFds.size() > 1 || mode == VTUN_PIPE || shmPath != nullptr)) {
+        SPDLOG_INFO("epoll reactor needs one queue without -p or -x,"
+                    " using threads");
+        reactor = false;
+    }
+
+    // The threads wait for readiness instead of blocking in read() and
+    // write(), io_cancel() wakes them up. The other engines poll themselves.
+    if (nonBlocking && !ring && !reactor) {
+        if (io_wait_init(waitTimeoutMs) < 0) {
+            SPDLOG_ERROR("io_wait_init() error({}) {}", errno,
+                         strerror(errno));
+        }
+        std::vector<int> fds(tapFds);
+        fds.push_back(serialFd);
+        for (int nonBlockingFd : fds) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            int flags = fcntl(nonBlockingFd, F_GETFL);
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            if (flags < 0 ||
+                fcntl(nonBlockingFd, F_SETFL, flags | O_NONBLOCK) < 0) {
+                SPDLOG_ERROR("fcntl() error({}) {}", errno, strerror(errno));
+            }
+        }
+    }
+
+    // splice() replaces the copies of the threads engine, frames are moved
+    // as they are
+    if (CommConfig::splicePassthrough &&
+        (ring || reactor || red_node || mode == VTUN_PIPE ||
+         CommConfig::cobsFraming || CommConfig::batchSize > 0 ||
+         !CommConfig::spliceCapable(serialFd, tapFds[0]))) {
+        SPDLOG_INFO("splice needs a pipe or stream socket transport, a TAP"
+                    " that splices (Linux before 5.10), -f len and no -m,"
+                    " -b, -r or -p, copying");
+        CommConfig::splicePassthrough = false;
+    }
 
     SPDLOG_INFO("Starting threads");
     try {
-        CommDevices::extensionPtr_t extension;
-        if (red_node) {
-            extension = std::make_shared<Pipe>();
+        Engines engines = {tapFds,  serialFd,    mode,       ring.get(),
+                           reactor, nonBlocking, handoffPath};
+        if (shmPath != nullptr) {
+            // The RED processing runs in the peer process
+            SPDLOG_INFO("Waiting for the RED process on {}", shmPath);
+            std::shared_ptr<ExtensionPoint> extension =
+                ShmPipe::serve(shmPath, CommConfig::frameLength());
+            if (!extension) {
+                throw std::system_error(errno, std::generic_category(),
+                                        "ShmPipe::serve()");
+            }
+            return run_engines(engines, extension);
+        }
+        if (!red_node) {
+            return run_engines<NoExtension>(engines, nullptr);
         }
-        CommDevices threadParams(tapFd, serialFd, mode, extension);
 
-        // Create threads
-        std::thread tap2serial(
-            std::bind(&CommDevices::tapToSerial, threadParams));
-        std::thread serial2tap(
-            std::bind(&CommDevices::serialToTap, threadParams));
+        // The reactor polls the extension, queues mean many writers
+        bool pipes = reactor || tapFds.size() > 1;
+        if (chainStages == 1 && pipes) {
+            return run_engines(engines, std::make_shared<Pipe>());
+        }
 
-        // NOTE: selftest only:
-        if (red_node || (mode == VTUN_PIPE)) {
-            std::thread outBound(
-                std::bind(&CommDevices::readOutBound, threadParams));
-            outBound.detach();
-            std::thread inBound(
-                std::bind(&CommDevices::readInBound, threadParams));
-            inBound.detach();
+        // The rings pass references to pool buffers, the pool has room for
+        // full rings and the packet each forwarding thread holds
+        if (!pipes) {
+            CommConfig::packetPool = std::make_shared<PacketPool>(
+                chainStages * 2 * RingPipe::RING_SLOTS + 2 * (chainStages + 1),
+                CommConfig::frameLength(), hugePages);
+            if (!CommConfig::packetPool->valid()) {
+                throw std::system_error(errno, std::generic_category(),
+                                        "PacketPool");
+            }
+        }
+        if (chainStages == 1) {
+            return run_engines(engines, std::make_shared<RingPipe>(
+                                            CommConfig::packetPool));
         }
 
-        // NOTE: selftest only:
-        if (mode == VTUN_PIPE) {
-            alarm(4); // NOTE: XXX watchdog timer: send unhandled SIGALRM after
-                      // 4 sec! CK
-            char msg[] = "Hallo\n";
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-            (void)write_n(1, msg, sizeof(msg)); // stdout
-            // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
-            if (readn_t(0, msg, sizeof(msg), 3) < 0) {
-                SPDLOG_INFO("Timeout while read from stdin");
+        std::vector<ExtensionChain::stage_t> stages;
+        for (size_t i = 0; i < chainStages; i++) {
+            if (pipes) {
+                stages.push_back(std::make_shared<Pipe>());
             } else {
-                sleep(1);
+                stages.push_back(
+                    std::make_shared<RingPipe>(CommConfig::packetPool));
             }
-
-            shutdown(serialFd, SHUT_WR);
-            shutdown(tapFd, SHUT_WR);
-            extension.reset();
         }
-
-        tap2serial.join();
-        SPDLOG_INFO("Thread tapToSerial joined ");
-        close(tapFd);
-
-        serial2tap.join();
-        SPDLOG_INFO("Thread serialToTap joined ");
-        close(serialFd);
-
-        return EXIT_SUCCESS;
+        // The forwarders go to the cores after the TAP queues
+        std::shared_ptr<ExtensionPoint> chain =
+            std::make_shared<ExtensionChain>(
+                std::move(stages), CommConfig::frameLength(),
+                static_cast<int>(tapFds.size()), CommConfig::packetPool);
+        return run_engines(engines, chain);
     } catch (std::exception &e) {
         SPDLOG_ERROR("Exception {}", e.what());
     }
 
-    close(tapFd);
+    for (int queueFd : tapFds) {
+        close(queueFd);
+    }
     close(serialFd);
     return EXIT_FAILURE;
 }
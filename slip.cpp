@@ -1,91 +1,78 @@
 #include "slip.h"
 
+namespace {
+typedef FrameCodec<SlipFraming> SlipCodec;
+typedef FrameCodec<SlipFraming, true> SlipCrcCodec;
+} // namespace
+
+enum slip_result slip_encode_isa(enum slip_isa isa, const inBuffer_t &frame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize)
+{
+    return SlipCodec::encode(isa, frame, frameLength, output, outputSize);
+}
+
 enum slip_result slip_encode(const inBuffer_t &frame, size_t frameLength,
                              Buffer_t &output, size_t *outputSize)
 {
-    size_t outputIndex = 0;
-    for (size_t inIndex = 0; inIndex < frameLength; inIndex++) {
-        // Check if we ran out of space on the output
-        if (output.size() <= outputIndex) {
-            SPDLOG_ERROR("SLIP buffer overflow error!");
-            return SLIP_BUFFER_OVERFLOW;
-        }
-
-        // Grab one byte from the input and check if we need to escape it
-        uint8_t c = frame[inIndex];
-        switch (c) {
-        case SLIP_END:
-            output[outputIndex] = SLIP_ESC;
-            output[outputIndex + 1] = SLIP_ESC_END;
-            outputIndex += 2;
-            break;
-        case SLIP_ESC:
-            output[outputIndex] = SLIP_ESC;
-            output[outputIndex + 1] = SLIP_ESC_ESC;
-            outputIndex += 2;
-            break;
-        default:
-            // No need to escape, copy as it is
-            output[outputIndex] = c;
-            outputIndex += 1;
-            break;
-        }
-    }
+    return slip_encode_isa(slip_cpu_isa(), frame, frameLength, output,
+                           outputSize);
+}
 
-    // Mark the frame end
-    output[outputIndex] = SLIP_END;
+enum slip_result slip_encode_batch(const inBuffer_t *frames, size_t frameCount,
+                                   Buffer_t &output, size_t *outputSize,
+                                   size_t *encodedCount)
+{
+    return SlipCodec::encodeBatch(slip_cpu_isa(), frames, frameCount, output,
+                                  outputSize, encodedCount);
+}
 
-    // Return the output size
-    *outputSize = outputIndex + 1;
-    return SLIP_OK;
+enum slip_result slip_decode_isa(enum slip_isa isa,
+                                 const inBuffer_t &encodedFrame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize)
+{
+    return SlipCodec::decode(isa, encodedFrame, frameLength, output,
+                             outputSize);
 }
 
 enum slip_result slip_decode(const inBuffer_t &encodedFrame, size_t frameLength,
                              Buffer_t &output, size_t *outputSize)
 {
-    int invalidEscape = 0;
+    return slip_decode_isa(slip_cpu_isa(), encodedFrame, frameLength, output,
+                           outputSize);
+}
+
+enum slip_result slip_decode_inplace(const inBuffer_t &frame,
+                                     size_t frameLength, inBuffer_t *decoded)
+{
+    return SlipCodec::decodeInPlace(slip_cpu_isa(), frame, frameLength,
+                                    decoded);
+}
 
-    size_t outputIndex = 0;
-    for (size_t inIndex = 0; inIndex < frameLength; inIndex++) {
-        // Check if we ran out of space on the output buffer
-        if (output.size() <= outputIndex) {
-            SPDLOG_ERROR("SLIP buffer overflow error!");
-            return SLIP_BUFFER_OVERFLOW;
-        }
+enum slip_result slip_encode_iov(const inBuffer_t &frame, size_t frameLength,
+                                 struct iovec *iov, size_t iovLength,
+                                 size_t *iovCount)
+{
+    return SlipCodec::encodeIov(frame, frameLength, iov, iovLength, iovCount);
+}
 
-        uint8_t inByte = encodedFrame[inIndex];
-        if (inByte == SLIP_ESC) {
-            switch (encodedFrame[inIndex + 1]) {
-            case SLIP_ESC_END:
-                output[outputIndex] = SLIP_END;
-                break;
-            case SLIP_ESC_ESC:
-                output[outputIndex] = SLIP_ESC;
-                break;
-            default:
-                // Escape sequence invalid, complain on stderr
-                output[outputIndex] = SLIP_ESC;
-                invalidEscape = 1;
-                SPDLOG_ERROR(
-                    "SLIP escape error! (Input bytes at({}): {:#04x}, {:#04x})",
-                    inIndex, inByte, encodedFrame[inIndex + 1]);
-                break;
-            }
-            inIndex += 1;
-        } else if (inByte == SLIP_END) {
-            // End of packet, stop the loop
-            // NOTE: NO! outputIndex++; XXX CK
-            break;
-        } else {
-            output[outputIndex] = inByte;
-        }
+enum slip_result slip_encode_crc(const inBuffer_t &frame, size_t frameLength,
+                                 Buffer_t &output, size_t *outputSize)
+{
+    return SlipCrcCodec::encode(slip_cpu_isa(), frame, frameLength, output,
+                                outputSize);
+}
 
-        outputIndex++;
-    }
+enum slip_result slip_decode_crc(const inBuffer_t &encodedFrame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize)
+{
+    return SlipCrcCodec::decode(slip_cpu_isa(), encodedFrame, frameLength,
+                                output, outputSize);
+}
 
-    *outputSize = outputIndex;
-    if (invalidEscape) {
-        return SLIP_INVALID_ESCAPE;
-    }
-    return SLIP_OK;
+size_t slip_find_end(const inBuffer_t &data, size_t offset, size_t length)
+{
+    return SlipCodec::findEnd(data, offset, length);
 }
@@ -5,10 +5,7 @@
 
 #pragma once
 
-#include "tun-driver.h"
-// XXX #include "gsl/gsl-lite.hpp"
-
-#include <vector>
+#include "framing.h"
 
 enum
 {
@@ -16,19 +13,44 @@ enum
     SLIP_ESC = 0xDB,
     SLIP_ESC_END = 0xDC,
     SLIP_ESC_ESC = 0xDD,
-    SLIP_IN_FRAME_LENGTH = 2048,
+    SLIP_IN_FRAME_LENGTH = FRAMING_IN_FRAME_LENGTH,
     SLIP_OUT_FRAME_LENGTH = 4098,
 };
 
-enum slip_result
+/**
+ * Framing policy of RFC 1055, no control characters are escaped
+ * @see FrameCodec
+ */
+struct SlipFraming
 {
-    SLIP_OK = 0,
-    SLIP_INVALID_ESCAPE = 1,
-    SLIP_BUFFER_OVERFLOW = 2,
+    static constexpr const char *name = "SLIP";
+    static constexpr uint8_t END = SLIP_END;
+    static constexpr uint8_t ESC = SLIP_ESC;
+    static constexpr uint32_t ACCM = 0;
+
+    static constexpr uint8_t escape(unsigned c)
+    {
+        return (c == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+    }
+
+    static constexpr int16_t unescape(unsigned c)
+    {
+        switch (c) {
+        case SLIP_ESC_END:
+            return SLIP_END;
+        case SLIP_ESC_ESC:
+            return SLIP_ESC;
+        default:
+            return -1;
+        }
+    }
 };
 
-typedef gsl::span<uint8_t> inBuffer_t;
-typedef std::vector<uint8_t> Buffer_t;
+/* Incremental SLIP decoder for the serial byte stream */
+typedef StreamDecoder<SlipFraming> SlipDecoder;
+
+/* Incremental SLIP decoder checking a CRC32C trailer on every frame */
+typedef StreamDecoder<SlipFraming, true> SlipCrcDecoder;
 
 /**
  * Encode a piece of data according to the SLIP standard
@@ -41,6 +63,47 @@ typedef std::vector<uint8_t> Buffer_t;
 enum slip_result slip_encode(const inBuffer_t &frame, size_t frameLength,
                              Buffer_t &output, size_t *outputSize);
 
+/**
+ * Encode a batch of frames back to back into one buffer, to send them with a
+ * single write. Every frame ends with one SLIP_END, which also starts the
+ * next frame. Frames that might not fit are left for the next batch.
+ * @param frames            Frames to encode, one span per frame
+ * @param frameCount        Number of frames
+ * @param output            Where to store the encoded frames
+ * @param outputSize        Where to store output length
+ * @param encodedCount      Where to store the number of frames encoded
+ * @return SLIP_OK for success, otherwise error code of the first frame
+ */
+enum slip_result slip_encode_batch(const inBuffer_t *frames, size_t frameCount,
+                                   Buffer_t &output, size_t *outputSize,
+                                   size_t *encodedCount);
+
+/**
+ * Encode a frame as a scatter-gather list for writev(), no payload byte is
+ * copied. Escape-free runs point into frame, the escape sequences and the
+ * SLIP_END point at static storage.
+ * @param frame             Data to encode, must stay valid until written
+ * @param frameLength       Data length
+ * @param iov               Where to store the list
+ * @param iovLength         Number of entries in iov
+ * @param iovCount          Where to store the number of entries used
+ * @return SLIP_OK for success, SLIP_BUFFER_OVERFLOW if iov is too short
+ */
+enum slip_result slip_encode_iov(const inBuffer_t &frame, size_t frameLength,
+                                 struct iovec *iov, size_t iovLength,
+                                 size_t *iovCount);
+
+/**
+ * Encode with an explicitly selected kernel, the output is byte-identical
+ * to slip_encode(). An ISA the CPU does not support falls back to the best
+ * one it does.
+ * @param isa               Kernel to use
+ * @see slip_encode()
+ */
+enum slip_result slip_encode_isa(enum slip_isa isa, const inBuffer_t &frame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize);
+
 /**
  * Decode a SLIP packet
  * @param encodedFrame      Data to decode
@@ -51,3 +114,55 @@ enum slip_result slip_encode(const inBuffer_t &frame, size_t frameLength,
  */
 enum slip_result slip_decode(const inBuffer_t &encodedFrame, size_t frameLength,
                              Buffer_t &output, size_t *outputSize);
+
+/**
+ * Decode a SLIP packet in place, the decoded data is compacted to the start
+ * of the buffer. It is never longer than the encoded data, no second buffer
+ * is needed.
+ * @param frame             Data to decode, overwritten by the decoded data
+ * @param frameLength       Data length
+ * @param decoded           Where to store the span of the decoded data
+ * @return SLIP_OK for success, otherwise error code
+ */
+enum slip_result slip_decode_inplace(const inBuffer_t &frame,
+                                     size_t frameLength, inBuffer_t *decoded);
+
+/**
+ * Decode with an explicitly selected kernel.
+ * Decoding stops at the first SLIP_END. After an invalid escape the rest of
+ * the frame is skipped and SLIP_INVALID_ESCAPE is returned, the output then
+ * ends with the offending SLIP_ESC.
+ * @param isa               Kernel to use
+ * @see slip_decode()
+ */
+enum slip_result slip_decode_isa(enum slip_isa isa,
+                                 const inBuffer_t &encodedFrame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize);
+
+/**
+ * Encode a frame with a CRC32C trailer, 4 bytes little endian in front of the
+ * SLIP_END. The CRC is computed in the same pass as the escaping.
+ * @see slip_encode()
+ */
+enum slip_result slip_encode_crc(const inBuffer_t &frame, size_t frameLength,
+                                 Buffer_t &output, size_t *outputSize);
+
+/**
+ * Decode a frame with a CRC32C trailer, check it and strip it
+ * @return SLIP_OK for success, SLIP_CRC_ERROR if the check fails, otherwise
+ *         error code
+ * @see slip_decode()
+ */
+enum slip_result slip_decode_crc(const inBuffer_t &encodedFrame,
+                                 size_t frameLength, Buffer_t &output,
+                                 size_t *outputSize);
+
+/**
+ * Find the next SLIP_END, e.g. to resync after an invalid escape
+ * @param data              Data to search
+ * @param offset            Where to start searching
+ * @param length            Data length
+ * @return Index of the SLIP_END, or length if there is none
+ */
+size_t slip_find_end(const inBuffer_t &data, size_t offset, size_t length);
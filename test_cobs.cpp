@@ -0,0 +1,215 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "cobs.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+
+const unsigned RANDOM_SEED = 1055;
+typedef std::vector<uint8_t> smallBuffer_t;
+
+// Random frame where about zeroPercent of the bytes are zero
+static smallBuffer_t randomFrame(size_t length, unsigned zeroPercent,
+                                 std::mt19937 &rng)
+{
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<unsigned> byte(1, UINT8_MAX);
+    smallBuffer_t frame(length);
+    for (auto &c : frame) {
+        c = (percent(rng) < zeroPercent) ? 0 : static_cast<uint8_t>(byte(rng));
+    }
+    return frame;
+}
+
+TEST_CASE("testCobsEncode")
+{
+    // Examples from the COBS paper (Cheshire, Baker 1999)
+    struct
+    {
+        smallBuffer_t frame;
+        smallBuffer_t encoded;
+    } vectors[] = {
+        {{}, {0x01, 0x00}},
+        {{0x00}, {0x01, 0x01, 0x00}},
+        {{0x00, 0x00}, {0x01, 0x01, 0x01, 0x00}},
+        {{0x11, 0x22, 0x00, 0x33}, {0x03, 0x11, 0x22, 0x02, 0x33, 0x00}},
+        {{0x11, 0x00, 0x00, 0x00}, {0x02, 0x11, 0x01, 0x01, 0x01, 0x00}},
+    };
+
+    for (auto &vector : vectors) {
+        smallBuffer_t outBuffer(cobs_max_encoded_length(vector.frame.size()));
+        size_t outSize = 0;
+        CHECK(cobs_encode(vector.frame, vector.frame.size(), outBuffer,
+                          &outSize) == SLIP_OK);
+        REQUIRE(outSize == vector.encoded.size());
+        CHECK(memcmp(outBuffer.data(), vector.encoded.data(), outSize) == 0);
+
+        smallBuffer_t decoded(vector.frame.size() + 1);
+        CHECK(cobs_decode(vector.encoded, vector.encoded.size(), decoded,
+                          &outSize) == SLIP_OK);
+        REQUIRE(outSize == vector.frame.size());
+        CHECK(memcmp(decoded.data(), vector.frame.data(), outSize) == 0);
+    }
+
+    // 254 bytes fill a block, the next one starts a new block
+    for (size_t length : {253, 254, 255, 508, 509}) {
+        smallBuffer_t frame(length, 0x42);
+        smallBuffer_t outBuffer(cobs_max_encoded_length(length));
+        size_t outSize = 0;
+        CHECK(cobs_encode(frame, length, outBuffer, &outSize) == SLIP_OK);
+        CHECK(outSize == length + (length + 253) / 254 + 1);
+        CHECK(outBuffer[0] == std::min<size_t>(length + 1, COBS_MAX_BLOCK));
+    }
+
+    // Too small an output buffer
+    smallBuffer_t frame(16, 0x42);
+    smallBuffer_t outBuffer(17);
+    size_t outSize = 0;
+    CHECK(cobs_encode(frame, frame.size(), outBuffer, &outSize) ==
+          SLIP_BUFFER_OVERFLOW);
+}
+
+TEST_CASE("testCobsRoundTrip")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<struct iovec> iov(COBS_OUT_FRAME_LENGTH);
+
+    for (size_t length : {0, 1, 253, 254, 255, 1500, 2048}) {
+        for (unsigned zeroPercent : {0, 1, 50, 100}) {
+            smallBuffer_t frame = randomFrame(length, zeroPercent, rng);
+            smallBuffer_t encoded(COBS_OUT_FRAME_LENGTH, 0xFF);
+            size_t encodedSize = 0;
+            REQUIRE(cobs_encode(frame, length, encoded, &encodedSize) ==
+                    SLIP_OK);
+            CHECK(encodedSize <= cobs_max_encoded_length(length));
+
+            // Only the delimiter is zero
+            CHECK(std::count(encoded.begin(), encoded.begin() + encodedSize,
+                             0) == 1);
+            CHECK(encoded[encodedSize - 1] == COBS_END);
+
+            smallBuffer_t decoded(FRAMING_IN_FRAME_LENGTH, 0);
+            size_t decodedSize = 0;
+            CHECK(cobs_decode(encoded, encodedSize, decoded, &decodedSize) ==
+                  SLIP_OK);
+            REQUIRE(decodedSize == length);
+            CHECK(memcmp(decoded.data(), frame.data(), length) == 0);
+
+            // Gather the list, it must match the copying encoder
+            size_t iovCount = 0;
+            REQUIRE(cobs_encode_iov(frame, length, iov.data(), iov.size(),
+                                    &iovCount) == SLIP_OK);
+            smallBuffer_t gathered;
+            for (size_t i = 0; i < iovCount; i++) {
+                const auto *base = static_cast<uint8_t *>(iov[i].iov_base);
+                gathered.insert(gathered.end(), base, base + iov[i].iov_len);
+            }
+            CHECK(gathered.size() == encodedSize);
+            CHECK(memcmp(gathered.data(), encoded.data(), encodedSize) == 0);
+        }
+    }
+}
+
+TEST_CASE("testCobsDecodeErrors")
+{
+    // Block cut short by the delimiter
+    smallBuffer_t truncated = {0x05, 0x11, 0x22, 0x00};
+    smallBuffer_t outBuffer(8);
+    size_t outSize = 0;
+    CHECK(cobs_decode(truncated, truncated.size(), outBuffer, &outSize) ==
+          SLIP_INVALID_ESCAPE);
+
+    // Too small an output buffer
+    smallBuffer_t encoded = {0x05, 0x11, 0x22, 0x33, 0x44, 0x00};
+    smallBuffer_t small(3);
+    CHECK(cobs_decode(encoded, encoded.size(), small, &outSize) ==
+          SLIP_BUFFER_OVERFLOW);
+}
+
+TEST_CASE("testCobsDecoder")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<smallBuffer_t> frames;
+    smallBuffer_t stream;
+
+    for (size_t length : {1, 40, 1500, 2, 254, 255, 700, 5}) {
+        frames.push_back(randomFrame(length, 10, rng));
+        smallBuffer_t encoded(COBS_OUT_FRAME_LENGTH, 0);
+        size_t encodedSize = 0;
+        REQUIRE(cobs_encode(frames.back(), length, encoded, &encodedSize) ==
+                SLIP_OK);
+        stream.insert(stream.end(), encoded.begin(),
+                      encoded.begin() + encodedSize);
+    }
+
+    for (size_t chunkSize : {1, 2, 3, 7, 64, 1000, 100000}) {
+        CobsDecoder decoder;
+        std::vector<smallBuffer_t> decoded;
+        for (size_t offset = 0; offset < stream.size(); offset += chunkSize) {
+            size_t length = std::min(chunkSize, stream.size() - offset);
+            inBuffer_t chunk(stream.data() + offset, length);
+            decoder.feed(chunk, length, [&decoded](const inBuffer_t &frame) {
+                decoded.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        CHECK(decoded == frames);
+        CHECK(decoder.frames() == frames.size());
+        CHECK(decoder.errors() == 0);
+    }
+}
+
+TEST_CASE("testCobsDecoderErrors")
+{
+    // A block cut short and a frame that is too long are dropped, the
+    // decoder resyncs at the next delimiter
+    smallBuffer_t first = {0x03, 0x01, 0x02, 0x00, 0x05, 0x03};
+    smallBuffer_t second = {0x00, 0x07, 1, 2, 3, 4, 5, 6, 0x00};
+    smallBuffer_t third = {0x00, 0x01, 0x01, 0x00};
+    std::vector<smallBuffer_t> expected = {{1, 2}, {0}};
+
+    CobsDecoder decoder(5);
+    std::vector<smallBuffer_t> decoded;
+    auto onFrame = [&decoded](const inBuffer_t &frame) {
+        decoded.emplace_back(frame.begin(), frame.end());
+    };
+    CHECK(decoder.feed(first, first.size(), onFrame) == 1);
+    CHECK(decoder.feed(second, second.size(), onFrame) == 0);
+    CHECK(decoder.feed(third, third.size(), onFrame) == 1);
+
+    CHECK(decoded == expected);
+    CHECK(decoder.frames() == 2);
+    CHECK(decoder.errors() == 2);
+}
+
+TEST_CASE("testCobsEncodeBatch")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<smallBuffer_t> frames;
+    std::vector<inBuffer_t> batch;
+    for (size_t length : {1, 300, 0, 64}) {
+        frames.push_back(randomFrame(length, 10, rng));
+    }
+    for (auto &frame : frames) {
+        batch.emplace_back(frame.data(), frame.size());
+    }
+
+    smallBuffer_t outBuffer(batch.size() * COBS_OUT_FRAME_LENGTH, 0xFF);
+    size_t outSize = 0;
+    size_t encodedCount = 0;
+    CHECK(cobs_encode_batch(batch.data(), batch.size(), outBuffer, &outSize,
+                            &encodedCount) == SLIP_OK);
+    CHECK(encodedCount == batch.size());
+
+    // The stream decoder splits the batch again
+    CobsDecoder decoder;
+    std::vector<smallBuffer_t> decoded;
+    decoder.feed(outBuffer, outSize, [&decoded](const inBuffer_t &frame) {
+        decoded.emplace_back(frame.begin(), frame.end());
+    });
+    frames.erase(frames.begin() + 2); // the empty frame is skipped
+    CHECK(decoded == frames);
+}
@@ -0,0 +1,51 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "crc32c.h"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+const unsigned RANDOM_SEED = 3720; // RFC 3720, iSCSI uses CRC32C
+
+TEST_CASE("testCrc32cCheckValue")
+{
+    const char *check = "123456789";
+    const auto *data = reinterpret_cast<const uint8_t *>(check);
+    CHECK(crc32c(data, strlen(check)) == 0xE3069283);
+    CHECK(crc32c(data, 0) == 0);
+
+    // 32 bytes of zeros, RFC 3720 B.4
+    std::vector<uint8_t> zeros(32, 0);
+    CHECK(crc32c(zeros.data(), zeros.size()) == 0x8A9136AA);
+}
+
+TEST_CASE("testCrc32cResidue")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::uniform_int_distribution<unsigned> byte(0, UINT8_MAX);
+
+    for (size_t length : {0, 1, 7, 8, 9, 63, 1500}) {
+        std::vector<uint8_t> data(length);
+        for (auto &c : data) {
+            c = static_cast<uint8_t>(byte(rng));
+        }
+
+        // Hardware and table give the same result, from every alignment
+        for (size_t offset = 0; offset < 8 && offset <= length; offset++) {
+            CHECK(crc32c_update(CRC32C_INIT, data.data() + offset,
+                                length - offset) ==
+                  crc32c_update_sw(CRC32C_INIT, data.data() + offset,
+                                   length - offset));
+        }
+
+        // The CRC appended little endian gives the residue
+        uint32_t crc = crc32c(data.data(), length);
+        for (unsigned i = 0; i < 4; i++) {
+            data.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+        }
+        CHECK(crc32c_update(CRC32C_INIT, data.data(), data.size()) ==
+              CRC32C_RESIDUE);
+    }
+}
@@ -0,0 +1,85 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "EpollReactor.h"
+
+#include <doctest/doctest.h>
+
+#include <cerrno>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+TEST_CASE("testEpollReactorReadable")
+{
+    EpollReactor reactor;
+    REQUIRE(reactor.valid());
+
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) == 0);
+
+    std::vector<std::string> received;
+    REQUIRE(reactor.add(fd[1], [&]() {
+        char buf[64];
+        ssize_t count;
+        while ((count = read(fd[1], buf, sizeof(buf))) > 0) {
+            received.emplace_back(buf, count);
+        }
+        CHECK(errno == EAGAIN);
+    }));
+
+    // Nothing to read, the timeout expires
+    CHECK(reactor.poll(0) == 0);
+
+    CHECK(write(fd[0], "one", 3) == 3);
+    CHECK(write(fd[0], "two!", 4) == 4);
+    CHECK(reactor.poll(100) == 1);
+    REQUIRE(received.size() == 2);
+    CHECK(received[0] == "one");
+    CHECK(received[1] == "two!");
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+TEST_CASE("testWriteQueue")
+{
+    EpollReactor reactor;
+    REQUIRE(reactor.valid());
+
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == 0);
+    int sndbuf = 4096;
+    setsockopt(fd[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    const size_t maxFrames = 4;
+    WriteQueue queue(reactor, fd[0], maxFrames);
+    REQUIRE(reactor.add(fd[0], nullptr, [&queue] { queue.flush(); }));
+
+    // Fill the socket until frames are queued, then until they are dropped
+    std::vector<char> frame(1000);
+    std::string sent;
+    size_t frames = 0;
+    while (queue.dropped() == 0) {
+        std::fill(frame.begin(), frame.end(), static_cast<char>('a' + frames));
+        if (queue.write(frame.data(), frame.size())) {
+            sent.append(frame.data(), frame.size());
+        }
+        frames++;
+    }
+    CHECK(queue.size() == maxFrames);
+
+    // The reader takes everything, EPOLLOUT drains the queue in order
+    std::string received;
+    while (received.size() < sent.size()) {
+        char buf[512];
+        ssize_t count = read(fd[1], buf, sizeof(buf));
+        REQUIRE(count > 0);
+        received.append(buf, count);
+        (void)reactor.poll(0);
+    }
+    CHECK(queue.size() == 0);
+    CHECK(received == sent);
+
+    close(fd[0]);
+    close(fd[1]);
+}
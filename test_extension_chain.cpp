@@ -0,0 +1,121 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "ExtensionChain.h"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+volatile bool __io_canceled = false;
+
+/* A stage that appends its tag to every packet it passes on */
+class Tag : public RingPipe
+{
+public:
+    explicit Tag(char _tag) : RingPipe(64, 4), tag(_tag) {}
+
+    ssize_t write(Channel id, const void *buf, size_t count) noexcept override
+    {
+        std::string packet(static_cast<const char *>(buf), count);
+        packet += tag;
+        ssize_t result = RingPipe::write(id, packet.data(), packet.size());
+        return (result < 0) ? result : static_cast<ssize_t>(count);
+    }
+
+private:
+    const char tag;
+};
+
+static std::string readString(ExtensionPoint &extension,
+                              ExtensionPoint::Channel id)
+{
+    char buf[64];
+    ssize_t count = extension.read(id, buf, sizeof(buf));
+    return (count < 0) ? std::string() : std::string(buf, count);
+}
+
+TEST_CASE("testChainOrder")
+{
+    ExtensionChain chain({std::make_shared<Tag>('1'),
+                          std::make_shared<Tag>('2'),
+                          std::make_shared<Tag>('3')},
+                         64);
+    CHECK(chain.size() == 3);
+
+    // OUTER to INNER through the stages in order, and back in reverse
+    CHECK(chain.write(ExtensionPoint::OUTER, "a", 1) == 1);
+    CHECK(readString(chain, ExtensionPoint::INNER) == "a123");
+    CHECK(chain.write(ExtensionPoint::INNER, "b", 1) == 1);
+    CHECK(readString(chain, ExtensionPoint::OUTER) == "b321");
+}
+
+TEST_CASE("testChainBatches")
+{
+    ExtensionChain chain(
+        {std::make_shared<Tag>('x'), std::make_shared<Tag>('y')}, 64);
+
+    // Many more packets than the stages hold, a full stage stops the writer
+    constexpr size_t COUNT = 1000;
+    std::vector<std::string> received;
+    std::thread reader([&]() {
+        PacketBatch batch(64, 8);
+        while (received.size() < COUNT) {
+            ssize_t count =
+                chain.readBatch(ExtensionPoint::INNER, batch.reset());
+            if (count <= 0) {
+                break;
+            }
+            for (ssize_t i = 0; i < count; i++) {
+                received.emplace_back(static_cast<const char *>(batch[i].buf),
+                                      batch[i].count);
+            }
+        }
+    });
+
+    for (size_t i = 0; i < COUNT; i++) {
+        std::string packet = std::to_string(i);
+        REQUIRE(chain.write(ExtensionPoint::OUTER, packet.data(),
+                            packet.size()) ==
+                static_cast<ssize_t>(packet.size()));
+    }
+    reader.join();
+
+    REQUIRE(received.size() == COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        CHECK(received[i] == std::to_string(i) + "xy");
+    }
+}
+
+TEST_CASE("testChainSingleStage")
+{
+    auto stage = std::make_shared<Tag>('s');
+    ExtensionChain chain({stage}, 64);
+    CHECK(chain.write(ExtensionPoint::OUTER, "c", 1) == 1);
+    CHECK(readString(*stage, ExtensionPoint::INNER) == "cs");
+}
+
+TEST_CASE("testChainPackets")
+{
+    // Pool buffers go through the stages as they are
+    auto pool = std::make_shared<PacketPool>(32, 64);
+    ExtensionChain chain({std::make_shared<RingPipe>(pool, 4),
+                          std::make_shared<RingPipe>(pool, 4),
+                          std::make_shared<RingPipe>(pool, 4)},
+                         64, -1, pool);
+
+    PacketRef packet = pool->allocate();
+    memcpy(packet.data(), "zero", 4);
+    packet.setLength(4);
+    const char *data = packet.data();
+    CHECK(chain.writePacket(ExtensionPoint::INNER, std::move(packet)));
+    PacketRef received = chain.readPacket(ExtensionPoint::OUTER, *pool);
+    REQUIRE(received);
+    CHECK(received.data() == data);
+    CHECK(std::string(received.data(), received.length()) == "zero");
+
+    // And copied in and out at the ends
+    CHECK(chain.write(ExtensionPoint::OUTER, "copy", 4) == 4);
+    CHECK(readString(chain, ExtensionPoint::INNER) == "copy");
+}
@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "ExtensionPoint.h"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+volatile bool __io_canceled = false;
+
+/* Only the single packet calls, for the default batch methods */
+class Loop : public Pipe
+{
+public:
+    ssize_t readBatch(Channel id, gsl::span<Packet> packets) noexcept override
+    {
+        return ExtensionPoint::readBatch(id, packets);
+    }
+    ssize_t writeBatch(Channel id,
+                       gsl::span<const Packet> packets) noexcept override
+    {
+        return ExtensionPoint::writeBatch(id, packets);
+    }
+};
+
+static void checkBatch(ExtensionPoint &extension, size_t perRead)
+{
+    std::vector<std::string> sent = {"one", "two!", "three", "four"};
+    std::vector<ExtensionPoint::Packet> packets;
+    for (std::string &packet : sent) {
+        packets.push_back({&packet[0], packet.size()});
+    }
+    CHECK(extension.writeBatch(ExtensionPoint::OUTER, packets) ==
+          static_cast<ssize_t>(sent.size()));
+
+    // The boundaries are kept
+    PacketBatch batch(64, 8);
+    std::vector<std::string> received;
+    while (received.size() < sent.size()) {
+        ssize_t count = extension.readBatch(ExtensionPoint::INNER,
+                                            batch.reset());
+        REQUIRE(count > 0);
+        CHECK(static_cast<size_t>(count) <= perRead);
+        for (ssize_t i = 0; i < count; i++) {
+            received.emplace_back(static_cast<const char *>(batch[i].buf),
+                                  batch[i].count);
+        }
+    }
+    CHECK(received == sent);
+}
+
+TEST_CASE("testPipeBatch")
+{
+    Pipe pipe;
+    checkBatch(pipe, 8);
+}
+
+TEST_CASE("testPipeBatchTruncated")
+{
+    // A packet longer than its buffer is dropped, not passed on cut
+    Pipe pipe;
+    std::string large(100, 'x');
+    CHECK(pipe.write(ExtensionPoint::OUTER, large.data(), large.size()) ==
+          100);
+    CHECK(pipe.write(ExtensionPoint::OUTER, "fits", 4) == 4);
+    PacketBatch batch(64, 8);
+    REQUIRE(pipe.readBatch(ExtensionPoint::INNER, batch.reset()) == 1);
+    CHECK(std::string(static_cast<const char *>(batch[0].buf),
+                      batch[0].count) == "fits");
+
+    CHECK(pipe.write(ExtensionPoint::OUTER, large.data(), large.size()) ==
+          100);
+    CHECK(pipe.readBatch(ExtensionPoint::INNER, batch.reset()) == -1);
+    CHECK(errno == EMSGSIZE);
+}
+
+TEST_CASE("testDefaultBatch")
+{
+    Loop loop;
+    checkBatch(loop, 1);
+}
+
+TEST_CASE("testRingPipeBatch")
+{
+    RingPipe rings(64, 8);
+    checkBatch(rings, 8);
+
+    // The other direction
+    char packet[] = "back";
+    CHECK(rings.write(ExtensionPoint::INNER, packet, 4) == 4);
+    char buf[8] = {};
+    CHECK(rings.read(ExtensionPoint::OUTER, buf, sizeof(buf)) == 4);
+    CHECK(std::string(buf) == "back");
+}
+
+TEST_CASE("testRingPipePool")
+{
+    auto pool = std::make_shared<PacketPool>(8, 64);
+    RingPipe rings(pool, 4);
+    checkBatch(rings, 8);
+    CHECK(pool->available() == 8);
+
+    // The buffer itself goes through
+    PacketRef packet = pool->allocate();
+    memcpy(packet.data(), "ref", 3);
+    packet.setLength(3);
+    const char *data = packet.data();
+    CHECK(rings.writePacket(ExtensionPoint::OUTER, std::move(packet)));
+    PacketRef received = rings.readPacket(ExtensionPoint::INNER, *pool);
+    REQUIRE(received);
+    CHECK(received.data() == data);
+    CHECK(received.length() == 3);
+
+    // The pool bounds the packets in flight
+    CHECK(rings.write(ExtensionPoint::OUTER, "a", 1) == 1);
+    std::vector<PacketRef> held;
+    while (PacketRef more = pool->allocate()) {
+        held.push_back(std::move(more));
+    }
+    CHECK(rings.write(ExtensionPoint::INNER, "b", 1) == -1);
+    CHECK(errno == ENOBUFS);
+}
+
+TEST_CASE("testRingPipePoolInFlight")
+{
+    auto pool = std::make_shared<PacketPool>(4, 64);
+    {
+        RingPipe rings(pool);
+        CHECK(rings.write(ExtensionPoint::OUTER, "left", 4) == 4);
+        CHECK(rings.write(ExtensionPoint::INNER, "over", 4) == 4);
+        CHECK(pool->available() == 2);
+    }
+    CHECK(pool->available() == 4);
+}
+
+TEST_CASE("testDefaultPacket")
+{
+    PacketPool pool(2, 64);
+    Pipe pipe;
+    PacketRef packet = pool.allocate();
+    memcpy(packet.data(), "copy", 4);
+    packet.setLength(4);
+    CHECK(pipe.writePacket(ExtensionPoint::OUTER, packet));
+
+    // Read into a buffer of the pool
+    PacketRef received = pipe.readPacket(ExtensionPoint::INNER, pool);
+    REQUIRE(received);
+    CHECK(received.data() != packet.data());
+    CHECK(std::string(received.data(), received.length()) == "copy");
+
+    CHECK(pipe.write(ExtensionPoint::OUTER, "none", 4) == 4);
+    CHECK(!pipe.readPacket(ExtensionPoint::INNER, pool));
+    CHECK(errno == ENOBUFS);
+}
+
+TEST_CASE("testRingPipeCanceled")
+{
+    RingPipe rings(64, 8);
+    std::thread reader([&rings]() {
+        char buf[8];
+        CHECK(rings.read(ExtensionPoint::INNER, buf, sizeof(buf)) == -1);
+        CHECK(errno == ECANCELED);
+    });
+    __io_canceled = true;
+    reader.join();
+    __io_canceled = false;
+}
+
+TEST_CASE("testEmptyBatch")
+{
+    Pipe pipe;
+    CHECK(pipe.writeBatch(ExtensionPoint::OUTER, {}) == 0);
+}
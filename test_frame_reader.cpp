@@ -0,0 +1,175 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "FrameReader.h"
+#include "FrameWriter.h"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+volatile bool __io_canceled = false;
+
+namespace {
+
+/* Every frame the reader has after one fill() */
+std::vector<std::string> readFrames(FrameReader &reader, int fd)
+{
+    std::vector<std::string> frames;
+    reader.read(fd, [&frames](const char *frame, size_t length) {
+        frames.emplace_back(frame, length);
+    });
+    return frames;
+}
+
+} // namespace
+
+TEST_CASE("testFrameReaderStream")
+{
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == 0);
+
+    // Three frames, the stream is cut inside a header and inside a payload
+    std::string stream;
+    for (const char *payload : {"one", "two!", "three"}) {
+        stream += '\0';
+        stream += static_cast<char>(strlen(payload));
+        stream += payload;
+    }
+    const size_t cuts[] = {1, 7, 12, stream.size()};
+
+    FrameReader reader;
+    std::vector<std::string> frames;
+    size_t offset = 0;
+    for (size_t cut : cuts) {
+        REQUIRE(write(fd[0], stream.data() + offset, cut - offset) ==
+                static_cast<ssize_t>(cut - offset));
+        offset = cut;
+        for (auto &frame : readFrames(reader, fd[1])) {
+            frames.push_back(frame);
+        }
+    }
+    REQUIRE(frames.size() == 3);
+    CHECK(frames[0] == "one");
+    CHECK(frames[1] == "two!");
+    CHECK(frames[2] == "three");
+    CHECK(reader.buffered() == 0);
+
+    // Many frames, one read
+    for (int i = 0; i < 10; i++) {
+        char frame[] = "frame";
+        REQUIRE(frame_write(fd[0], frame, sizeof(frame)) > 0);
+    }
+    CHECK(readFrames(reader, fd[1]).size() == 10);
+    CHECK(reader.frames() == 13);
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+TEST_CASE("testFrameReaderSpace")
+{
+    // Bytes read by the caller, a frame split over two reads
+    const char stream[] = {0, 3, 'a', 'b', 'c', 0, 2, 'd'};
+    FrameReader reader;
+    size_t room = 0;
+    char *free = reader.space(&room);
+    REQUIRE(room >= sizeof(stream));
+    memcpy(free, stream, sizeof(stream));
+    reader.commit(sizeof(stream));
+
+    const char *frame = nullptr;
+    size_t length = 0;
+    REQUIRE(reader.next(&frame, &length));
+    CHECK(std::string(frame, length) == "abc");
+    CHECK(!reader.next(&frame, &length));
+    CHECK(reader.buffered() == 3);
+
+    free = reader.space(&room);
+    *free = 'e';
+    reader.commit(1);
+    REQUIRE(reader.next(&frame, &length));
+    CHECK(std::string(frame, length) == "de");
+}
+
+TEST_CASE("testFrameReaderSegmented")
+{
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, fd) == 0);
+
+    std::vector<char> frame(ETHER_FRAME_LEN_MASK + 100);
+    for (size_t i = 0; i < frame.size(); i++) {
+        frame[i] = static_cast<char>(i * 7);
+    }
+
+    // A super-frame is joined, a plain reader drops it
+    for (size_t maxFrameLength : {TUN_OFFLOAD_FRAME_LENGTH, size_t(1500)}) {
+        FrameReader reader(maxFrameLength);
+        REQUIRE(frame_write_segmented(fd[0], frame.data(), frame.size()) > 0);
+        char tail[] = "tail";
+        REQUIRE(frame_write(fd[0], tail, sizeof(tail)) > 0);
+
+        std::vector<std::string> frames;
+        while (frames.empty() || frames.back() != std::string(tail, 5)) {
+            for (auto &received : readFrames(reader, fd[1])) {
+                frames.push_back(received);
+            }
+        }
+        if (maxFrameLength > frame.size()) {
+            REQUIRE(frames.size() == 2);
+            CHECK(frames[0] == std::string(frame.data(), frame.size()));
+        } else {
+            CHECK(frames.size() == 1);
+            CHECK(reader.errors() == 1);
+        }
+    }
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+TEST_CASE("testFrameWriterBatch")
+{
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) == 0);
+    int idle[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, idle) == 0);
+
+    // Five frames of 12 bytes with their headers fit into one transfer
+    FrameWriter writer(fd[0], 64, std::chrono::seconds(1));
+    char frame[] = "0123456789";
+    for (int i = 0; i < 5; i++) {
+        CHECK(writer.write(frame, 10) == 12);
+    }
+    CHECK(writer.transfers() == 0);
+    CHECK(writer.write(frame, 10) == 12);
+    CHECK(writer.transfers() == 1);
+
+    // One transfer is one message, the reader splits it
+    FrameReader reader;
+    CHECK(readFrames(reader, fd[1]).size() == 5);
+
+    // The last frame is written when its deadline passes
+    FrameWriter fast(fd[0], 64, std::chrono::milliseconds(5));
+    CHECK(fast.write(frame, 10) == 12);
+    CHECK(fast.waitReadable(idle[1]) == false);
+    CHECK(fast.transfers() == 1);
+    CHECK(readFrames(reader, fd[1]).size() == 1);
+
+    // The sixth frame is still collected
+    CHECK(writer.flush() == 12);
+    CHECK(readFrames(reader, fd[1]).size() == 1);
+
+    // Too large for a transfer, written on its own
+    std::vector<char> large(100, 'x');
+    CHECK(writer.write(large.data(), large.size()) == 102);
+    CHECK(writer.transfers() == 3);
+    auto frames = readFrames(reader, fd[1]);
+    REQUIRE(frames.size() == 1);
+    CHECK(frames[0] == std::string(large.data(), large.size()));
+
+    close(fd[0]);
+    close(fd[1]);
+    close(idle[0]);
+    close(idle[1]);
+}
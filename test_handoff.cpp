@@ -0,0 +1,144 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "Handoff.h"
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+TEST_CASE("testHandoffNobodyListening")
+{
+    std::string path = "/tmp/test_handoff." + std::to_string(getpid());
+    unlink(path.c_str());
+
+    struct handoff_state state = {};
+    int fds[HANDOFF_MAX_FDS];
+    int sock = -1;
+    CHECK(handoff_take(path.c_str(), &sock, &state, fds, HANDOFF_MAX_FDS) ==
+          0);
+}
+
+TEST_CASE("testHandoffGiveTake")
+{
+    std::string path = "/tmp/test_handoff." + std::to_string(getpid());
+    int listenFd = handoff_listen(path.c_str());
+    REQUIRE(listenFd >= 0);
+
+    int pair[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+
+    // The old instance
+    int given = -1;
+    std::thread old([&]() {
+        struct handoff_state state = {};
+        state.flags = HANDOFF_OFFLOAD;
+        strncpy(state.adapterName, "ut7", IF_NAMESIZE - 1);
+        given = handoff_give(listenFd, &state, pair, 2, 1000);
+    });
+
+    struct handoff_state state = {};
+    int fds[HANDOFF_MAX_FDS];
+    int sock = -1;
+    int count =
+        handoff_take(path.c_str(), &sock, &state, fds, HANDOFF_MAX_FDS);
+    REQUIRE(count == 2);
+    CHECK(state.flags == HANDOFF_OFFLOAD);
+    CHECK(std::string(state.adapterName) == "ut7");
+    CHECK(handoff_ack(sock) == 0);
+    old.join();
+    CHECK(given == 0);
+
+    // The received fds are the same sockets
+    CHECK(write(fds[0], "ping", 4) == 4);
+    char buf[8] = {};
+    CHECK(read(pair[1], buf, sizeof(buf)) == 4);
+    CHECK(std::string(buf) == "ping");
+
+    for (int fd : {fds[0], fds[1], pair[0], pair[1], listenFd}) {
+        close(fd);
+    }
+    unlink(path.c_str());
+}
+
+TEST_CASE("testHandoffNoAck")
+{
+    std::string path = "/tmp/test_handoff." + std::to_string(getpid());
+    int listenFd = handoff_listen(path.c_str());
+    REQUIRE(listenFd >= 0);
+
+    int pair[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, pair) == 0);
+
+    int given = 0;
+    std::thread old([&]() {
+        struct handoff_state state = {};
+        given = handoff_give(listenFd, &state, pair, 2, 100);
+    });
+
+    // The new instance dies before it acknowledged the fds
+    struct handoff_state state = {};
+    int fds[HANDOFF_MAX_FDS];
+    int sock = -1;
+    REQUIRE(handoff_take(path.c_str(), &sock, &state, fds,
+                         HANDOFF_MAX_FDS) == 2);
+    old.join();
+    CHECK(given == -1);
+    close(sock);
+
+    for (int fd : {fds[0], fds[1], pair[0], pair[1], listenFd}) {
+        close(fd);
+    }
+    unlink(path.c_str());
+}
+
+TEST_CASE("testHandoffBadVersion")
+{
+    std::string path = "/tmp/test_handoff." + std::to_string(getpid());
+    int listenFd = handoff_listen(path.c_str());
+    REQUIRE(listenFd >= 0);
+
+    int pipeFds[2] = {-1, -1};
+    REQUIRE(pipe2(pipeFds, O_NONBLOCK) == 0);
+
+    // Another release, handoff_give() would send its own version
+    std::thread old([&]() {
+        int fd = accept(listenFd, nullptr, nullptr);
+        struct handoff_state state = {};
+        state.version = 99;
+        struct iovec iov = {&state, sizeof(state)};
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &pipeFds[1], sizeof(int));
+        CHECK(sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(state));
+        close(fd);
+    });
+
+    struct handoff_state state = {};
+    int fds[HANDOFF_MAX_FDS];
+    int sock = -1;
+    CHECK(handoff_take(path.c_str(), &sock, &state, fds, HANDOFF_MAX_FDS) ==
+          -1);
+    CHECK(errno == EPROTO);
+    old.join();
+
+    // The received write end was closed, the pipe has no writer left
+    close(pipeFds[1]);
+    char byte = 0;
+    CHECK(read(pipeFds[0], &byte, 1) == 0);
+
+    close(pipeFds[0]);
+    close(listenFd);
+    unlink(path.c_str());
+}
@@ -0,0 +1,81 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "IoUring.h"
+
+#include <doctest/doctest.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+TEST_CASE("testIoUringReadWrite")
+{
+    IoUring ring(8);
+    if (!ring.valid()) {
+        MESSAGE("io_uring not available, skipped");
+        return;
+    }
+
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) == 0);
+
+    // Registered buffer for the reads, plain memory for the writes
+    std::vector<char> arena(4 * 64, 0);
+    bool registered = ring.registerBuffer(arena.data(), arena.size());
+    MESSAGE("buffers registered: " << registered);
+
+    for (uint64_t i = 0; i < 4; i++) {
+        REQUIRE(ring.prepRead(fd[1], arena.data() + i * 64, 64, 100 + i));
+    }
+    const char *messages[] = {"one", "two!", "three"};
+    for (uint64_t i = 0; i < 3; i++) {
+        REQUIRE(ring.prepWrite(fd[0], messages[i], strlen(messages[i]), i,
+                               i < 2));
+    }
+    REQUIRE(ring.submit() == 7);
+
+    // One message per read
+    std::map<uint64_t, int32_t> results;
+    while (results.size() < 6) {
+        REQUIRE(ring.submit(1) >= 0);
+        ring.reap([&results](uint64_t userData, int32_t result) {
+            results[userData] = result;
+        });
+    }
+    std::set<std::string> sent;
+    std::set<std::string> received;
+    uint64_t pending = 0;
+    for (uint64_t i = 0; i < 3; i++) {
+        CHECK(results[i] == static_cast<int32_t>(strlen(messages[i])));
+        sent.insert(messages[i]);
+    }
+    for (uint64_t i = 0; i < 4; i++) {
+        // Any posted read may take a message
+        if (results.count(100 + i) == 0) {
+            pending = 100 + i;
+            continue;
+        }
+        REQUIRE(results[100 + i] > 0);
+        received.emplace(arena.data() + i * 64, results[100 + i]);
+    }
+    CHECK(received == sent);
+
+    // The last read is still posted, the timeout completes
+    REQUIRE(ring.prepTimeout(10, 200));
+    results.clear();
+    while (results.count(200) == 0) {
+        REQUIRE(ring.submit(1) >= 0);
+        ring.reap([&results](uint64_t userData, int32_t result) {
+            results[userData] = result;
+        });
+    }
+    CHECK(results[200] == -ETIME);
+    CHECK(results.count(pending) == 0);
+
+    close(fd[0]);
+    close(fd[1]);
+}
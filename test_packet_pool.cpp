@@ -0,0 +1,109 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "PacketPool.h"
+
+#include <doctest/doctest.h>
+
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST_CASE("testPoolBounded")
+{
+    PacketPool pool(4, 100);
+    REQUIRE(pool.valid());
+    CHECK(pool.size() == 4);
+    CHECK(pool.available() == 4);
+
+    std::vector<PacketRef> packets;
+    for (int i = 0; i < 4; i++) {
+        packets.push_back(pool.allocate());
+        REQUIRE(packets.back());
+        CHECK(packets.back().capacity() == 100);
+        CHECK(packets.back().length() == 0);
+    }
+    CHECK(pool.available() == 0);
+    CHECK(!pool.allocate());
+
+    // A dropped packet can be allocated again
+    packets.pop_back();
+    CHECK(pool.available() == 1);
+    CHECK(pool.allocate());
+}
+
+TEST_CASE("testPoolAligned")
+{
+    PacketPool pool(3, 100);
+    for (int i = 0; i < 3; i++) {
+        PacketRef packet = pool.allocate();
+        CHECK(reinterpret_cast<uintptr_t>(packet.data()) %
+                  PacketPool::CACHE_LINE ==
+              0);
+        memset(packet.data(), 0xff, packet.capacity());
+    }
+}
+
+TEST_CASE("testRefCounted")
+{
+    PacketPool pool(2, 64);
+    PacketRef packet = pool.allocate();
+    memcpy(packet.data(), "shared", 6);
+    packet.setLength(6);
+    CHECK(packet.useCount() == 1);
+
+    {
+        // Copies share the buffer, the last one returns it
+        PacketRef copy = packet;
+        CHECK(copy.data() == packet.data());
+        CHECK(copy.length() == 6);
+        CHECK(packet.useCount() == 2);
+        packet.reset();
+        CHECK(!packet);
+        CHECK(copy.useCount() == 1);
+        CHECK(pool.available() == 1);
+    }
+    CHECK(pool.available() == 2);
+
+    // Passed on as a plain pointer, the reference is kept
+    PacketRef moved = pool.allocate();
+    char *data = moved.data();
+    void *released = moved.release();
+    CHECK(!moved);
+    CHECK(pool.available() == 1);
+    PacketRef adopted = PacketRef::adopt(released);
+    CHECK(adopted.data() == data);
+    CHECK(adopted.useCount() == 1);
+    adopted = PacketRef();
+    CHECK(pool.available() == 2);
+}
+
+TEST_CASE("testPoolThreads")
+{
+    PacketPool pool(8, 64);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&pool]() {
+            for (int i = 0; i < 10000; i++) {
+                PacketRef packet = pool.allocate();
+                if (packet) {
+                    PacketRef copy = packet;
+                    packet.setLength(1);
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    CHECK(pool.available() == 8);
+}
+
+TEST_CASE("testPoolHugePages")
+{
+    // Without reserved huge pages it falls back to normal pages
+    PacketPool pool(16, 2048, true);
+    REQUIRE(pool.valid());
+    PacketRef packet = pool.allocate();
+    memset(packet.data(), 0, packet.capacity());
+    CHECK(pool.available() == 15);
+}
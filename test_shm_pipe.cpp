@@ -0,0 +1,92 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "ShmPipe.h"
+
+#include <doctest/doctest.h>
+
+#include <cerrno>
+#include <chrono>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+volatile bool __io_canceled = false;
+
+/* The RED process: copy count packets from OUTER to INNER and back */
+static int runPeer(const std::string &path, int count)
+{
+    std::unique_ptr<ShmPipe> peer;
+    for (int i = 0; !peer && i < 200; i++) {
+        peer = ShmPipe::attach(path.c_str());
+        if (!peer) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+    if (!peer) {
+        return 1;
+    }
+
+    char buf[64];
+    for (int i = 0; i < count; i++) {
+        ssize_t length = peer->read(ExtensionPoint::OUTER, buf, sizeof(buf));
+        if (length <= 0 ||
+            peer->write(ExtensionPoint::INNER, buf, length) != length) {
+            return 2;
+        }
+        length = peer->read(ExtensionPoint::INNER, buf, sizeof(buf));
+        if (length <= 0 ||
+            peer->write(ExtensionPoint::OUTER, buf, length) != length) {
+            return 3;
+        }
+    }
+    return 0;
+}
+
+TEST_CASE("testShmPipeTwoProcesses")
+{
+    constexpr int COUNT = 1000;
+    std::string path = "/tmp/test_shm_pipe." + std::to_string(getpid());
+
+    pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+        _exit(runPeer(path, COUNT));
+    }
+
+    std::unique_ptr<ShmPipe> host = ShmPipe::serve(path.c_str(), 64, 4);
+    REQUIRE(host);
+
+    // Same as Pipe: written to OUTER, read from INNER
+    char buf[64];
+    for (int i = 0; i < COUNT; i++) {
+        std::string outer = "outer" + std::to_string(i);
+        REQUIRE(host->write(ExtensionPoint::OUTER, outer.data(),
+                            outer.size()) ==
+                static_cast<ssize_t>(outer.size()));
+        ssize_t length = host->read(ExtensionPoint::INNER, buf, sizeof(buf));
+        REQUIRE(std::string(buf, length) == outer);
+
+        std::string inner = "inner" + std::to_string(i);
+        REQUIRE(host->write(ExtensionPoint::INNER, inner.data(),
+                            inner.size()) ==
+                static_cast<ssize_t>(inner.size()));
+        length = host->read(ExtensionPoint::OUTER, buf, sizeof(buf));
+        REQUIRE(std::string(buf, length) == inner);
+    }
+
+    int status = -1;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+
+    // The peer is gone, a wait ends
+    CHECK(host->read(ExtensionPoint::INNER, buf, sizeof(buf)) == -1);
+    CHECK(errno == EPIPE);
+}
+
+TEST_CASE("testShmPipeNoHost")
+{
+    std::string path = "/tmp/test_shm_pipe." + std::to_string(getpid());
+    unlink(path.c_str());
+    CHECK(ShmPipe::attach(path.c_str()) == nullptr);
+}
@@ -3,14 +3,36 @@
 
 #include <doctest/doctest.h>
 
+#include <algorithm>
 #include <cstring>
+#include <random>
 #include <vector>
 
 const size_t BUF_MIN = 6;
 const size_t BUF_MAX = 8;
 const size_t BUF_LEN = 5;
+const unsigned RANDOM_SEED = 1055; // RFC 1055
 typedef std::vector<uint8_t> smallBuffer_t;
 
+// Random frame where about escapePercent of the bytes need escaping
+static smallBuffer_t randomFrame(size_t length, unsigned escapePercent,
+                                 std::mt19937 &rng)
+{
+    std::uniform_int_distribution<unsigned> percent(0, 99);
+    std::uniform_int_distribution<unsigned> byte(0, UINT8_MAX);
+    smallBuffer_t frame(length);
+    for (auto &c : frame) {
+        if (percent(rng) < escapePercent) {
+            c = (percent(rng) & 1) ? SLIP_END : SLIP_ESC;
+        } else {
+            do {
+                c = static_cast<uint8_t>(byte(rng));
+            } while (c == SLIP_END || c == SLIP_ESC);
+        }
+    }
+    return frame;
+}
+
 TEST_CASE("testDecode")
 {
     // Decode the packet that is marked by SLIP_END
@@ -150,3 +172,493 @@ TEST_CASE("testEncodeErrors")
     CHECK(result == SLIP_BUFFER_OVERFLOW);
     CHECK(outSize == 0);
 }
+
+TEST_CASE("testEncodeIsa")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    const enum slip_isa isaList[] = {SLIP_ISA_SSE2, SLIP_ISA_AVX2};
+
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1500,
+                          static_cast<int>(SLIP_IN_FRAME_LENGTH)}) {
+        for (unsigned escapePercent : {0, 1, 10, 50, 100}) {
+            smallBuffer_t inBuffer = randomFrame(length, escapePercent, rng);
+            smallBuffer_t expected(SLIP_OUT_FRAME_LENGTH, 0);
+            size_t expectedSize = 0;
+            REQUIRE(slip_encode_isa(SLIP_ISA_SCALAR, inBuffer, length,
+                                    expected, &expectedSize) == SLIP_OK);
+
+            for (enum slip_isa isa : isaList) {
+                smallBuffer_t outBuffer(SLIP_OUT_FRAME_LENGTH, 0);
+                size_t outSize = 0;
+
+                CHECK(slip_encode_isa(isa, inBuffer, length, outBuffer,
+                                      &outSize) == SLIP_OK);
+                CHECK(outSize == expectedSize);
+                CHECK(memcmp(expected.data(), outBuffer.data(), outSize) ==
+                      0);
+
+                // An exactly sized output fits, one byte less overflows
+                smallBuffer_t exact(expectedSize, 0);
+                CHECK(slip_encode_isa(isa, inBuffer, length, exact,
+                                      &outSize) == SLIP_OK);
+                smallBuffer_t tooSmall(expectedSize - 1, 0);
+                CHECK(slip_encode_isa(isa, inBuffer, length, tooSmall,
+                                      &outSize) == SLIP_BUFFER_OVERFLOW);
+            }
+        }
+    }
+}
+
+TEST_CASE("testDecodeIsa")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    const enum slip_isa isaList[] = {SLIP_ISA_SCALAR, SLIP_ISA_SSE2,
+                                     SLIP_ISA_AVX2};
+
+    for (size_t length : {0, 1, 15, 16, 17, 31, 32, 33, 100, 1500,
+                          static_cast<int>(SLIP_IN_FRAME_LENGTH)}) {
+        for (unsigned escapePercent : {0, 1, 10, 50, 100}) {
+            smallBuffer_t frame = randomFrame(length, escapePercent, rng);
+            smallBuffer_t inBuffer(SLIP_OUT_FRAME_LENGTH, 0);
+            size_t inSize = 0;
+            REQUIRE(slip_encode(frame, length, inBuffer, &inSize) == SLIP_OK);
+
+            for (enum slip_isa isa : isaList) {
+                smallBuffer_t outBuffer(SLIP_IN_FRAME_LENGTH, 0);
+                size_t outSize = 0;
+
+                CHECK(slip_decode_isa(isa, inBuffer, inSize, outBuffer,
+                                      &outSize) == SLIP_OK);
+                CHECK(outSize == length);
+                CHECK(memcmp(frame.data(), outBuffer.data(), outSize) == 0);
+
+                // An exactly sized output fits
+                smallBuffer_t exact(length, 0);
+                CHECK(slip_decode_isa(isa, inBuffer, inSize, exact,
+                                      &outSize) == SLIP_OK);
+            }
+        }
+    }
+}
+
+TEST_CASE("testDecodeIsaErrors")
+{
+    const enum slip_isa isaList[] = {SLIP_ISA_SCALAR, SLIP_ISA_SSE2,
+                                     SLIP_ISA_AVX2};
+
+    for (enum slip_isa isa : isaList) {
+        // Invalid escape behind a vector worth of payload, the rest of the
+        // frame is skipped
+        smallBuffer_t inBuffer(SLIP_IN_FRAME_LENGTH, 'x');
+        inBuffer[40] = SLIP_ESC;
+        inBuffer[41] = 'y';
+        inBuffer[100] = SLIP_END;
+        smallBuffer_t outBuffer(SLIP_IN_FRAME_LENGTH, 0);
+        size_t outSize = 0;
+
+        CHECK(slip_decode_isa(isa, inBuffer, inBuffer.size(), outBuffer,
+                              &outSize) == SLIP_INVALID_ESCAPE);
+        CHECK(outSize == 41);
+        CHECK(outBuffer[40] == SLIP_ESC);
+        CHECK(slip_find_end(inBuffer, 41, inBuffer.size()) == 100);
+        CHECK(slip_find_end(inBuffer, 101, inBuffer.size()) ==
+              inBuffer.size());
+
+        // A frame must not end in the middle of an escape sequence
+        smallBuffer_t truncated = {0, 1, 2, SLIP_ESC};
+        CHECK(slip_decode_isa(isa, truncated, truncated.size(), outBuffer,
+                              &outSize) == SLIP_INVALID_ESCAPE);
+        CHECK(outSize == truncated.size());
+    }
+}
+
+TEST_CASE("testSlipDecoder")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<smallBuffer_t> frames;
+    smallBuffer_t stream;
+
+    // A burst of small and large frames, back to back
+    for (size_t length : {1, 40, 1500, 2, 64, 33, 700, 5}) {
+        frames.push_back(randomFrame(length, 10, rng));
+        smallBuffer_t encoded(SLIP_OUT_FRAME_LENGTH, 0);
+        size_t encodedSize = 0;
+        REQUIRE(slip_encode(frames.back(), length, encoded, &encodedSize) ==
+                SLIP_OK);
+        stream.insert(stream.end(), encoded.begin(),
+                      encoded.begin() + encodedSize);
+    }
+
+    for (size_t chunkSize : {1, 2, 3, 7, 64, 1000, 100000}) {
+        SlipDecoder decoder;
+        std::vector<smallBuffer_t> decoded;
+        smallBuffer_t input = stream; // decoded in place
+        for (size_t offset = 0; offset < input.size(); offset += chunkSize) {
+            size_t length = std::min(chunkSize, input.size() - offset);
+            inBuffer_t chunk(input.data() + offset, length);
+            decoder.feed(chunk, length, [&decoded](const inBuffer_t &frame) {
+                decoded.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        CHECK(decoded == frames);
+        CHECK(decoder.frames() == frames.size());
+        CHECK(decoder.errors() == 0);
+    }
+}
+
+TEST_CASE("testSlipDecoderErrors")
+{
+    // Invalid escape split across chunks, a frame that is too long and an
+    // empty frame are dropped, the decoder resyncs at the next SLIP_END
+    smallBuffer_t first = {1, 2, SLIP_END, 3, SLIP_ESC};
+    smallBuffer_t second = {'x', 4, SLIP_END, SLIP_END, 5, 6, 7, 8, 9, 10};
+    smallBuffer_t third = {SLIP_END, SLIP_ESC, SLIP_ESC_ESC, SLIP_END};
+    std::vector<smallBuffer_t> expected = {{1, 2}, {SLIP_ESC}};
+
+    SlipDecoder decoder(BUF_LEN);
+    std::vector<smallBuffer_t> decoded;
+    auto onFrame = [&decoded](const inBuffer_t &frame) {
+        decoded.emplace_back(frame.begin(), frame.end());
+    };
+    CHECK(decoder.feed(first, first.size(), onFrame) == 1);
+    CHECK(decoder.feed(second, second.size(), onFrame) == 0);
+    CHECK(decoder.feed(third, third.size(), onFrame) == 1);
+
+    CHECK(decoded == expected);
+    CHECK(decoder.frames() == 2);
+    CHECK(decoder.errors() == 2);
+}
+
+TEST_CASE("testEncodeIov")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<struct iovec> iov(SLIP_OUT_FRAME_LENGTH);
+
+    for (size_t length : {0, 1, 33, 1500}) {
+        for (unsigned escapePercent : {0, 1, 50, 100}) {
+            smallBuffer_t inBuffer = randomFrame(length, escapePercent, rng);
+            smallBuffer_t expected(SLIP_OUT_FRAME_LENGTH, 0);
+            size_t expectedSize = 0;
+            REQUIRE(slip_encode(inBuffer, length, expected, &expectedSize) ==
+                    SLIP_OK);
+
+            size_t iovCount = 0;
+            CHECK(slip_encode_iov(inBuffer, length, iov.data(), iov.size(),
+                                  &iovCount) == SLIP_OK);
+
+            // Gather the list, it must match the copying encoder
+            smallBuffer_t gathered;
+            for (size_t i = 0; i < iovCount; i++) {
+                const auto *base = static_cast<uint8_t *>(iov[i].iov_base);
+                gathered.insert(gathered.end(), base, base + iov[i].iov_len);
+            }
+            CHECK(gathered.size() == expectedSize);
+            CHECK(memcmp(expected.data(), gathered.data(), expectedSize) == 0);
+
+            // Without escapes the payload is not copied
+            if (escapePercent == 0 && length > 0) {
+                CHECK(iovCount == 2);
+                CHECK(iov[0].iov_base == inBuffer.data());
+            }
+
+            // An exactly sized list fits, one entry less overflows
+            size_t exactCount = iovCount;
+            CHECK(slip_encode_iov(inBuffer, length, iov.data(), exactCount,
+                                  &iovCount) == SLIP_OK);
+            CHECK(slip_encode_iov(inBuffer, length, iov.data(), exactCount - 1,
+                                  &iovCount) == SLIP_BUFFER_OVERFLOW);
+        }
+    }
+}
+
+TEST_CASE("testHdlcEncode")
+{
+    // RFC 1662 async framing, control characters are escaped with the
+    // default ACCM only
+    smallBuffer_t inBuffer = {0x7E, 0x7D, 0x01, 0x41, 0x20};
+    smallBuffer_t expected = {0x7D, 0x5E, 0x7D, 0x5D, 0x7D, 0x21,
+                              0x41, 0x20, 0x7E};
+    smallBuffer_t expectedNoAccm = {0x7D, 0x5E, 0x7D, 0x5D, 0x01,
+                                    0x41, 0x20, 0x7E};
+
+    for (auto isa : {SLIP_ISA_SCALAR, SLIP_ISA_SSE2, SLIP_ISA_AVX2}) {
+        smallBuffer_t outBuffer(BUF_MAX * 2, 0);
+        size_t outSize = 0;
+        CHECK(FrameCodec<PppFraming>::encode(isa, inBuffer, inBuffer.size(),
+                                             outBuffer, &outSize) == SLIP_OK);
+        REQUIRE(outSize == expected.size());
+        CHECK(memcmp(outBuffer.data(), expected.data(), outSize) == 0);
+
+        CHECK(FrameCodec<HdlcFraming<0>>::encode(isa, inBuffer,
+                                                 inBuffer.size(), outBuffer,
+                                                 &outSize) == SLIP_OK);
+        REQUIRE(outSize == expectedNoAccm.size());
+        CHECK(memcmp(outBuffer.data(), expectedNoAccm.data(), outSize) == 0);
+
+        // Raw control characters are inserted by the line, not the peer
+        smallBuffer_t noisy = {0x11, 0x7D, 0x5E, 0x13, 0x41, 0x7E};
+        CHECK(FrameCodec<PppFraming>::decode(isa, noisy, noisy.size(),
+                                             outBuffer, &outSize) == SLIP_OK);
+        REQUIRE(outSize == 2);
+        CHECK(outBuffer[0] == 0x7E);
+        CHECK(outBuffer[1] == 0x41);
+
+        // 0x7D 0x7E aborts the frame
+        smallBuffer_t aborted = {0x41, 0x7D, 0x7E};
+        CHECK(FrameCodec<PppFraming>::decode(isa, aborted, aborted.size(),
+                                             outBuffer, &outSize) ==
+              SLIP_INVALID_ESCAPE);
+    }
+}
+
+TEST_CASE("testHdlcRoundTrip")
+{
+    typedef FrameCodec<PppFraming> HdlcCodec;
+    std::mt19937 rng(RANDOM_SEED);
+    std::uniform_int_distribution<unsigned> byte(0, UINT8_MAX);
+    std::vector<smallBuffer_t> frames;
+    smallBuffer_t stream;
+
+    for (size_t length : {1, 31, 32, 33, 1500, 64, 7}) {
+        smallBuffer_t frame(length);
+        for (auto &c : frame) {
+            c = static_cast<uint8_t>(byte(rng));
+        }
+
+        // Every kernel encodes the same, the decoders restore the frame
+        smallBuffer_t expected(length * 2 + 1, 0);
+        size_t expectedSize = 0;
+        REQUIRE(HdlcCodec::encode(SLIP_ISA_SCALAR, frame, length, expected,
+                                  &expectedSize) == SLIP_OK);
+        for (auto isa : {SLIP_ISA_SSE2, SLIP_ISA_AVX2}) {
+            smallBuffer_t encoded(length * 2 + 1, 0);
+            size_t encodedSize = 0;
+            CHECK(HdlcCodec::encode(isa, frame, length, encoded,
+                                    &encodedSize) == SLIP_OK);
+            CHECK(encoded == expected);
+
+            smallBuffer_t decoded(length, 0);
+            size_t decodedSize = 0;
+            CHECK(HdlcCodec::decode(isa, encoded, encodedSize, decoded,
+                                    &decodedSize) == SLIP_OK);
+            CHECK(decodedSize == length);
+            CHECK(decoded == frame);
+        }
+
+        frames.push_back(frame);
+        stream.insert(stream.end(), expected.begin(),
+                      expected.begin() + expectedSize);
+    }
+
+    StreamDecoder<PppFraming> decoder;
+    std::vector<smallBuffer_t> decoded;
+    for (size_t offset = 0; offset < stream.size(); offset += 3) {
+        size_t length = std::min<size_t>(3, stream.size() - offset);
+        inBuffer_t chunk(stream.data() + offset, length);
+        decoder.feed(chunk, length, [&decoded](const inBuffer_t &frame) {
+            decoded.emplace_back(frame.begin(), frame.end());
+        });
+    }
+    CHECK(decoded == frames);
+    CHECK(decoder.errors() == 0);
+}
+
+TEST_CASE("testEncodeBatch")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<smallBuffer_t> frames;
+    std::vector<inBuffer_t> batch;
+    smallBuffer_t expected;
+
+    for (size_t length : {1, 40, 1500, 0, 64}) {
+        frames.push_back(randomFrame(length, 10, rng));
+    }
+    for (auto &frame : frames) {
+        batch.emplace_back(frame.data(), frame.size());
+        smallBuffer_t encoded(SLIP_OUT_FRAME_LENGTH, 0);
+        size_t encodedSize = 0;
+        REQUIRE(slip_encode(frame, frame.size(), encoded, &encodedSize) ==
+                SLIP_OK);
+        expected.insert(expected.end(), encoded.begin(),
+                        encoded.begin() + encodedSize);
+    }
+
+    // The batch is the frames back to back, one SLIP_END each
+    smallBuffer_t outBuffer(batch.size() * SLIP_OUT_FRAME_LENGTH, 0);
+    size_t outSize = 0;
+    size_t encodedCount = 0;
+    CHECK(slip_encode_batch(batch.data(), batch.size(), outBuffer, &outSize,
+                            &encodedCount) == SLIP_OK);
+    CHECK(encodedCount == batch.size());
+    REQUIRE(outSize == expected.size());
+    CHECK(memcmp(outBuffer.data(), expected.data(), outSize) == 0);
+    CHECK(std::count(outBuffer.begin(), outBuffer.begin() + outSize,
+                     SLIP_END) == static_cast<long>(batch.size()));
+
+    // Frames that might not fit are left for the next batch
+    smallBuffer_t shortBuffer(SLIP_OUT_FRAME_LENGTH / 4, 0);
+    CHECK(slip_encode_batch(batch.data(), batch.size(), shortBuffer, &outSize,
+                            &encodedCount) == SLIP_OK);
+    CHECK(encodedCount == 2);
+    CHECK(memcmp(shortBuffer.data(), expected.data(), outSize) == 0);
+
+    // The first frame has to fit
+    smallBuffer_t tinyBuffer(BUF_MIN, 0);
+    CHECK(slip_encode_batch(&batch[2], 1, tinyBuffer, &outSize,
+                            &encodedCount) == SLIP_BUFFER_OVERFLOW);
+}
+
+TEST_CASE("testDecodeInPlace")
+{
+    std::mt19937 rng(RANDOM_SEED);
+
+    for (size_t length : {0, 1, 33, 1500, 2048}) {
+        for (unsigned escapePercent : {0, 1, 10, 50, 100}) {
+            smallBuffer_t frame = randomFrame(length, escapePercent, rng);
+            smallBuffer_t encoded(SLIP_OUT_FRAME_LENGTH, 0);
+            size_t encodedSize = 0;
+            REQUIRE(slip_encode(frame, length, encoded, &encodedSize) ==
+                    SLIP_OK);
+
+            // Same result as decoding into a second buffer, for every kernel
+            for (auto isa : {SLIP_ISA_SCALAR, SLIP_ISA_SSE2, SLIP_ISA_AVX2}) {
+                smallBuffer_t input = encoded;
+                inBuffer_t decoded;
+                CHECK(FrameCodec<SlipFraming>::decodeInPlace(
+                          isa, input, encodedSize, &decoded) == SLIP_OK);
+                CHECK(decoded.data() == input.data());
+                REQUIRE(decoded.size() == length);
+                CHECK(memcmp(decoded.data(), frame.data(), length) == 0);
+            }
+
+            inBuffer_t decoded;
+            CHECK(slip_decode_inplace(encoded, encodedSize, &decoded) ==
+                  SLIP_OK);
+            CHECK(decoded.size() == length);
+        }
+    }
+
+    // Errors are reported like slip_decode()
+    smallBuffer_t invalid = {1, SLIP_ESC, 2, 3, SLIP_END};
+    inBuffer_t decoded;
+    CHECK(slip_decode_inplace(invalid, invalid.size(), &decoded) ==
+          SLIP_INVALID_ESCAPE);
+    CHECK(decoded.size() == 2);
+    CHECK(decoded[1] == SLIP_ESC);
+}
+
+TEST_CASE("testCrcRoundTrip")
+{
+    typedef FrameCodec<SlipFraming, true> SlipCrcCodec;
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<struct iovec> iov(SLIP_OUT_FRAME_LENGTH);
+
+    for (size_t length : {0, 1, 33, 1500, 2048}) {
+        for (unsigned escapePercent : {0, 1, 10, 100}) {
+            smallBuffer_t frame = randomFrame(length, escapePercent, rng);
+
+            // Same as the plain encoding of the frame and its CRC
+            smallBuffer_t withCrc = frame;
+            uint32_t crc = crc32c(frame.data(), length);
+            for (unsigned i = 0; i < 4; i++) {
+                withCrc.push_back(static_cast<uint8_t>(crc >> (8 * i)));
+            }
+            smallBuffer_t expected(SlipCrcCodec::maxEncodedLength(length));
+            size_t expectedSize = 0;
+            REQUIRE(slip_encode(withCrc, withCrc.size(), expected,
+                                &expectedSize) == SLIP_OK);
+
+            for (auto isa : {SLIP_ISA_SCALAR, SLIP_ISA_SSE2, SLIP_ISA_AVX2}) {
+                smallBuffer_t encoded(SlipCrcCodec::maxEncodedLength(length));
+                size_t encodedSize = 0;
+                REQUIRE(SlipCrcCodec::encode(isa, frame, length, encoded,
+                                             &encodedSize) == SLIP_OK);
+                REQUIRE(encodedSize == expectedSize);
+                CHECK(memcmp(encoded.data(), expected.data(), encodedSize) ==
+                      0);
+
+                smallBuffer_t decoded(SLIP_IN_FRAME_LENGTH + 4);
+                size_t decodedSize = 0;
+                CHECK(SlipCrcCodec::decode(isa, encoded, encodedSize, decoded,
+                                           &decodedSize) == SLIP_OK);
+                REQUIRE(decodedSize == length);
+                CHECK(memcmp(decoded.data(), frame.data(), length) == 0);
+
+                inBuffer_t inPlace;
+                CHECK(SlipCrcCodec::decodeInPlace(isa, encoded, encodedSize,
+                                                  &inPlace) == SLIP_OK);
+                REQUIRE(inPlace.size() == length);
+                CHECK(memcmp(inPlace.data(), frame.data(), length) == 0);
+            }
+
+            // Gather the list, it must match the copying encoder
+            size_t iovCount = 0;
+            REQUIRE(SlipCrcCodec::encodeIov(frame, length, iov.data(),
+                                            iov.size(), &iovCount) == SLIP_OK);
+            smallBuffer_t gathered;
+            for (size_t i = 0; i < iovCount; i++) {
+                const auto *base = static_cast<uint8_t *>(iov[i].iov_base);
+                gathered.insert(gathered.end(), base, base + iov[i].iov_len);
+            }
+            CHECK(gathered.size() == expectedSize);
+            CHECK(memcmp(gathered.data(), expected.data(), expectedSize) == 0);
+        }
+    }
+
+    // A flipped bit or a frame shorter than the trailer fails the check
+    smallBuffer_t frame = randomFrame(100, 10, rng);
+    smallBuffer_t encoded(SLIP_OUT_FRAME_LENGTH);
+    size_t encodedSize = 0;
+    REQUIRE(slip_encode_crc(frame, frame.size(), encoded, &encodedSize) ==
+            SLIP_OK);
+    encoded[50] ^= 0x04;
+    smallBuffer_t decoded(SLIP_IN_FRAME_LENGTH);
+    size_t decodedSize = 0;
+    CHECK(slip_decode_crc(encoded, encodedSize, decoded, &decodedSize) ==
+          SLIP_CRC_ERROR);
+
+    smallBuffer_t tooShort = {1, 2, 3, SLIP_END};
+    CHECK(slip_decode_crc(tooShort, tooShort.size(), decoded, &decodedSize) ==
+          SLIP_CRC_ERROR);
+}
+
+TEST_CASE("testSlipCrcDecoder")
+{
+    std::mt19937 rng(RANDOM_SEED);
+    std::vector<smallBuffer_t> frames;
+    smallBuffer_t stream;
+
+    // The third frame is corrupted on the line
+    for (size_t length : {1, 40, 1500, 2, 64, 33, 700, 5}) {
+        frames.push_back(randomFrame(length, 10, rng));
+        smallBuffer_t encoded(SLIP_OUT_FRAME_LENGTH, 0);
+        size_t encodedSize = 0;
+        REQUIRE(slip_encode_crc(frames.back(), length, encoded,
+                                &encodedSize) == SLIP_OK);
+        if (frames.size() == 3) {
+            encoded[encodedSize / 2] ^= 0x01;
+        }
+        stream.insert(stream.end(), encoded.begin(),
+                      encoded.begin() + encodedSize);
+    }
+    frames.erase(frames.begin() + 2);
+
+    for (size_t chunkSize : {1, 2, 3, 7, 64, 1000, 100000}) {
+        SlipCrcDecoder decoder;
+        std::vector<smallBuffer_t> decoded;
+        smallBuffer_t input = stream; // decoded in place
+        for (size_t offset = 0; offset < input.size(); offset += chunkSize) {
+            size_t length = std::min(chunkSize, input.size() - offset);
+            inBuffer_t chunk(input.data() + offset, length);
+            decoder.feed(chunk, length, [&decoded](const inBuffer_t &frame) {
+                decoded.emplace_back(frame.begin(), frame.end());
+            });
+        }
+
+        CHECK(decoded == frames);
+        CHECK(decoder.frames() == frames.size());
+        CHECK(decoder.errors() == 1);
+        CHECK(decoder.crcErrors() == 1);
+    }
+}
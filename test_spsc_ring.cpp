@@ -0,0 +1,65 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "SpscRing.h"
+
+#include <doctest/doctest.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+
+TEST_CASE("testSpscRingFullEmpty")
+{
+    SpscRing ring(3, 16); // rounded up to 4 slots
+    char buf[16] = {};
+
+    // Empty, nothing to wait for
+    CHECK(ring.pop(buf, sizeof(buf), 0) == -1);
+    CHECK(errno == ETIMEDOUT);
+
+    for (int i = 0; i < 4; i++) {
+        std::string packet = "packet" + std::to_string(i);
+        CHECK(ring.push(packet.data(), packet.size(), 0) ==
+              static_cast<ssize_t>(packet.size()));
+    }
+    CHECK(ring.size() == 4);
+    CHECK(ring.push("full", 4, 10) == -1);
+    CHECK(errno == ETIMEDOUT);
+
+    CHECK(ring.pop(buf, sizeof(buf), 0) == 7);
+    CHECK(std::string(buf, 7) == "packet0");
+    CHECK(ring.push("again", 5, 0) == 5);
+
+    // Too long for a slot, and truncated like a datagram
+    char large[17] = {};
+    CHECK(ring.push(large, sizeof(large), 0) == -1);
+    CHECK(errno == EMSGSIZE);
+    CHECK(ring.pop(buf, 3, 0) == 3);
+    CHECK(std::string(buf, 3) == "pac");
+}
+
+TEST_CASE("testSpscRingThreads")
+{
+    constexpr int COUNT = 100000;
+    SpscRing ring(8, sizeof(int));
+
+    // The small ring makes both sides wait
+    std::thread producer([&ring]() {
+        for (int i = 0; i < COUNT; i++) {
+            REQUIRE(ring.push(&i, sizeof(i), -1) == sizeof(i));
+        }
+    });
+
+    int expected = 0;
+    for (; expected < COUNT; expected++) {
+        int value = -1;
+        REQUIRE(ring.pop(&value, sizeof(value), 1000) == sizeof(value));
+        if (value != expected) {
+            break;
+        }
+    }
+    producer.join();
+    CHECK(expected == COUNT);
+    CHECK(ring.size() == 0);
+    MESSAGE("futex waits: " << ring.waits());
+}
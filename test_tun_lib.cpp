@@ -0,0 +1,96 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include "tun-driver.h"
+
+#include <doctest/doctest.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+volatile bool __io_canceled = false;
+
+TEST_CASE("testFrameSegmented")
+{
+    // Message boundaries like the serial driver's frames
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) == 0);
+
+    for (size_t length :
+         {size_t(1), size_t(1500), size_t(ETHER_FRAME_LEN_MASK),
+          size_t(ETHER_FRAME_LEN_MASK) + 1, TUN_OFFLOAD_FRAME_LENGTH}) {
+        std::vector<char> frame(length);
+        for (size_t i = 0; i < length; i++) {
+            frame[i] = static_cast<char>(i * 7);
+        }
+
+        // One piece per ETHER_FRAME_LEN_MASK bytes, each with its header
+        size_t pieces = (length + ETHER_FRAME_LEN_MASK - 1) /
+            ETHER_FRAME_LEN_MASK;
+        CHECK(frame_write_segmented(fd[0], frame.data(), length) ==
+              static_cast<ssize_t>(length + pieces * sizeof(uint16_t)));
+
+        // All pieces but the last one are flagged
+        std::vector<char> received(length);
+        size_t total = 0;
+        for (size_t piece = 0; piece < pieces; piece++) {
+            ssize_t hdr =
+                frame_read(fd[1], received.data() + total, length - total);
+            REQUIRE(hdr > 0);
+            CHECK(((hdr & ETHER_FRAME_MORE) != 0) == (piece + 1 < pieces));
+            total += hdr & ETHER_FRAME_LEN_MASK;
+        }
+        CHECK(total == length);
+        CHECK(memcmp(received.data(), frame.data(), length) == 0);
+    }
+
+    close(fd[0]);
+    close(fd[1]);
+}
+
+TEST_CASE("testIoWait")
+{
+    int fd[2] = {-1, -1};
+    REQUIRE(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fd) == 0);
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    REQUIRE(fcntl(fd[1], F_SETFL, O_NONBLOCK) == 0);
+    REQUIRE(io_wait_init(50) == 0);
+
+    // Nothing comes, the read waits instead of spinning and times out
+    std::vector<char> received(64);
+    struct io_wait_stats before = io_get_wait_stats();
+    CHECK(frame_read(fd[1], received.data(), received.size()) < 0);
+    CHECK(errno == ETIMEDOUT);
+    struct io_wait_stats after = io_get_wait_stats();
+    CHECK(after.retries == before.retries + 1);
+    CHECK(after.waits == before.waits + 1);
+    CHECK(after.timeouts == before.timeouts + 1);
+
+    // A frame that comes later is read after one wait
+    REQUIRE(io_wait_init(1000) == 0);
+    std::thread writer([&fd] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        char frame[] = "late";
+        (void)frame_write(fd[0], frame, sizeof(frame));
+    });
+    CHECK(frame_read(fd[1], received.data(), received.size()) ==
+          static_cast<ssize_t>(sizeof("late")));
+    writer.join();
+    CHECK(strcmp(received.data(), "late") == 0);
+
+    // io_cancel() ends the wait at once, not after the timeout
+    REQUIRE(io_wait_init(-1) == 0);
+    std::thread canceler([] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        io_cancel();
+    });
+    CHECK(io_wait(fd[1], POLLIN) < 0);
+    CHECK(errno == ECANCELED);
+    canceler.join();
+    __io_canceled = false;
+
+    close(fd[0]);
+    close(fd[1]);
+}
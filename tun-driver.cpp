@@ -12,8 +12,16 @@
 #ifdef __linux__
 #    include <linux/if_tun.h>
 
-int tun_open_common(
-    char *dev, enum tun_mode_t mode) // NOLINT(readability-non-const-parameter)
+// Linux 6.2, older headers do not have them
+#    ifndef TUN_F_USO4
+#        define TUN_F_USO4 0x20
+#    endif
+#    ifndef TUN_F_USO6
+#        define TUN_F_USO6 0x40
+#    endif
+
+/* Open one fd of the device, flags are added to the TUNSETIFF request */
+static int tun_open_flags(char *dev, enum tun_mode_t mode, int flags)
 {
     if ((mode != VTUN_ETHER) && (mode != VTUN_P2P)) {
         return -1;
@@ -36,7 +44,7 @@ int tun_open_common(
     // Initialize the ifreq structure with 0s and the set flags
     memset(&ifr, 0, sizeof(ifr));
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
-    ifr.ifr_flags = (mode ? IFF_TUN : IFF_TAP) | IFF_NO_PI;
+    ifr.ifr_flags = (mode ? IFF_TUN : IFF_TAP) | IFF_NO_PI | flags;
 
     // If a device name is passed we should add it to the ifreq struct
     // Otherwise the kernel will try to allocate the next available
@@ -56,6 +64,25 @@ int tun_open_common(
         return err;
     }
 
+    // Let the kernel hand over unsegmented TCP and UDP super-frames with
+    // partial checksums, the virtio_net_hdr in front tells the peer how to
+    // finish. UDP segmentation offload needs Linux 6.2, without it only TCP.
+    if ((flags & IFF_VNET_HDR) != 0) {
+        unsigned offload = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6 | TUN_F_TSO_ECN;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+        err = ioctl(fileDescriptor, TUNSETOFFLOAD,
+                    offload | TUN_F_USO4 | TUN_F_USO6);
+        if (err < 0 && errno == EINVAL) {
+            // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+            err = ioctl(fileDescriptor, TUNSETOFFLOAD, offload);
+        }
+        if (err < 0) {
+            perror("ioctl TUNSETOFFLOAD");
+            close(fileDescriptor);
+            return err;
+        }
+    }
+
     // Write the device name back to the dev variable so the caller
     // can access it
     // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
@@ -65,6 +92,54 @@ int tun_open_common(
     return fileDescriptor;
 }
 
+int tun_open_common(
+    char *dev, enum tun_mode_t mode) // NOLINT(readability-non-const-parameter)
+{
+    return tun_open_flags(dev, mode, 0);
+}
+
+int tun_open_queues(char *dev, enum tun_mode_t mode, int *fds,
+                    size_t queueCount, bool offload)
+{
+    int flags = offload ? IFF_VNET_HDR : 0;
+    if (queueCount == 1) {
+        fds[0] = tun_open_flags(dev, mode, flags);
+        return (fds[0] < 0) ? -1 : 1;
+    }
+
+    // The first open creates the device and sets dev, the others attach
+    // another queue to it
+    for (size_t i = 0; i < queueCount; i++) {
+        fds[i] = tun_open_flags(dev, mode, flags | IFF_MULTI_QUEUE);
+        if (fds[i] < 0) {
+            int err = errno;
+            while (i > 0) {
+                close(fds[--i]);
+            }
+            errno = err;
+            return -1;
+        }
+    }
+    return static_cast<int>(queueCount);
+}
+
+int tun_set_persist(int fd, bool persist)
+{
+    struct ifreq ifr = {};
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (ioctl(fd, TUNGETIFF, &ifr) < 0) {
+        return -1;
+    }
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-union-access)
+    int wasPersistent = (ifr.ifr_flags & IFF_PERSIST) ? 1 : 0;
+
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-type-vararg)
+    if (ioctl(fd, TUNSETPERSIST, persist ? 1 : 0) < 0) {
+        return -1;
+    }
+    return wasPersistent;
+}
+
 #else
 
 int tun_open_common(
@@ -108,4 +183,22 @@ int tun_open_common(
     return -1;
 }
 
+int tun_open_queues(char *dev, enum tun_mode_t mode, int *fds,
+                    size_t queueCount, bool offload)
+{
+    // Multi-queue devices and offloads are Linux only
+    if (queueCount != 1 || offload) {
+        errno = ENOTSUP;
+        return -1;
+    }
+    fds[0] = tun_open_common(dev, mode);
+    return (fds[0] < 0) ? -1 : 1;
+}
+
+int tun_set_persist(int /*fd*/, bool /*persist*/)
+{
+    errno = ENOTSUP;
+    return -1;
+}
+
 #endif
@@ -18,12 +18,17 @@
 
 #include <fcntl.h>
 #include <net/if.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 constexpr uint16_t ETHER_FRAME_LEN_MASK(0x7fff);
 constexpr uint16_t ETHER_FRAME_LENGTH(0x8000);
+// Length header flag: the frame continues in the next one
+constexpr uint16_t ETHER_FRAME_MORE(0x8000);
+// Largest GSO super-frame with its virtio_net_hdr, offload mode only
+constexpr size_t TUN_OFFLOAD_FRAME_LENGTH(0x10000 + 16);
 
 enum tun_mode_t
 {
@@ -40,10 +45,69 @@ enum tun_mode_t
  */
 int tun_open_common(char *dev, enum tun_mode_t mode);
 
+/**
+ * Create a new multi-queue TUN adapter (IFF_MULTI_QUEUE), every queue has
+ * its own file descriptor and the kernel spreads the flows over them
+ * @param dev       The new adapter's path
+ * @param mode      The new adapter's mode
+ * @param fds       Where to store the queueCount file descriptors
+ * @param queueCount Number of queues, 1 opens a plain device
+ * @param offload   Set IFF_VNET_HDR and enable checksum and TSO offload, the
+ *                  frames then start with a virtio_net_hdr and may be GSO
+ *                  super-frames of up to TUN_OFFLOAD_FRAME_LENGTH
+ * @return Number of queues opened, or -1 on error (none is left open)
+ */
+int tun_open_queues(char *dev, enum tun_mode_t mode, int *fds,
+                    size_t queueCount, bool offload = false);
+
+/**
+ * Let the adapter outlive its last fd (TUNSETPERSIST), or not
+ * @param fd        Any fd of the adapter
+ * @return 1 if it was persistent before, 0 if not, -1 on error
+ */
+int tun_set_persist(int fd, bool persist);
+
 /* IO cancelation */
 extern volatile bool __io_canceled;
+// eventfd readable after io_cancel(), -1 until io_wait_init()
+inline int __io_cancel_fd = -1;
 static inline bool io_is_enabled() { return !__io_canceled; }
-static inline void io_cancel() { __io_canceled = true; }
+static inline void io_cancel()
+{
+    __io_canceled = true;
+    if (__io_cancel_fd >= 0) {
+        // NOTE: async signal safe, called by signal handlers
+        uint64_t one = 1;
+        (void)!write(__io_cancel_fd, &one, sizeof(one));
+    }
+}
+
+/**
+ * Set up waiting for readiness: on EAGAIN read_n(), write_n() and the
+ * frame_*() functions poll() the fd together with the cancelation eventfd
+ * instead of retrying at once. Needed for non-blocking fds only.
+ * @param timeoutMs Longest wait for one fd, -1 for no limit. A call that
+ *                  waited longer fails with ETIMEDOUT.
+ * @return 0, or -1 if the eventfd could not be created
+ */
+int io_wait_init(int timeoutMs);
+
+/**
+ * Wait until fd is ready for events (POLLIN or POLLOUT), or io_cancel()
+ * @return 0 if ready (or interrupted, check io_is_enabled()), -1 with errno
+ *         set on error, ETIMEDOUT after the io_wait_init() timeout and
+ *         ECANCELED after io_cancel()
+ */
+int io_wait(int fd, short events);
+
+/* Retries on EAGAIN or EINTR so far, to make the cost visible */
+struct io_wait_stats
+{
+    unsigned long retries;  // EAGAIN or EINTR
+    unsigned long waits;    // poll() calls
+    unsigned long timeouts; // waits that failed with ETIMEDOUT
+};
+struct io_wait_stats io_get_wait_stats();
 
 /* Read exactly len bytes (Signal safe) */
 int read_n(int fd, char *buf, size_t len);
@@ -75,5 +139,17 @@ static inline ssize_t pipe_read(int fd, char *buf, int len)
 ssize_t frame_write(int fd, char *buf, size_t len);
 ssize_t frame_read(int fd, char *buf, size_t len);
 
+/* Same for frames longer than ETHER_FRAME_LEN_MASK, they are split into
+ * pieces flagged with ETHER_FRAME_MORE except the last one. FrameReader
+ * joins them again. */
+ssize_t frame_write_segmented(int fd, char *buf, size_t len);
+
 /* Read N bytes with timeout */
 int readn_t(int fd, char *buf, size_t count, time_t timeout);
+
+/**
+ * Run the thread on one core only, to keep its packets local
+ * @param core      Taken modulo the number of cores
+ * @return 0, or the error number (logged)
+ */
+int pin_thread(pthread_t thread, unsigned core);
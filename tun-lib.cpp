@@ -1,9 +1,85 @@
 #include "tun-driver.h"
 
+#include <algorithm>
 #include <arpa/inet.h>
+#include <atomic>
 #include <cerrno>
+#include <cstring>
+#include <poll.h>
 #include <sys/uio.h>
 
+#ifdef __linux__
+#    include <sys/eventfd.h>
+#endif
+
+static int io_wait_timeout = -1;
+static std::atomic<unsigned long> io_retries{0};
+static std::atomic<unsigned long> io_waits{0};
+static std::atomic<unsigned long> io_timeouts{0};
+
+int io_wait_init(int timeoutMs)
+{
+    io_wait_timeout = timeoutMs;
+    if (__io_cancel_fd >= 0) {
+        return 0;
+    }
+
+#ifdef __linux__
+    __io_cancel_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (__io_cancel_fd < 0) {
+        return -1;
+    }
+    // Canceled before, the eventfd missed it
+    if (!io_is_enabled()) {
+        io_cancel();
+    }
+    return 0;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+int io_wait(int fd, short events)
+{
+    // The eventfd is never read, it stays readable after io_cancel()
+    struct pollfd fds[2] = {{fd, events, 0}, {__io_cancel_fd, POLLIN, 0}};
+    nfds_t count = (__io_cancel_fd >= 0) ? 2 : 1;
+
+    io_waits++;
+    // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
+    int ready = poll(fds, count, io_wait_timeout);
+    if (ready < 0) {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    if (ready == 0) {
+        io_timeouts++;
+        errno = ETIMEDOUT;
+        return -1;
+    }
+    if (!io_is_enabled()) {
+        errno = ECANCELED;
+        return -1;
+    }
+    return 0;
+}
+
+struct io_wait_stats io_get_wait_stats()
+{
+    return {io_retries.load(), io_waits.load(), io_timeouts.load()};
+}
+
+/* Retry after EAGAIN or EINTR, EAGAIN waits for the fd first
+ * @return false if the caller should fail with errno */
+static bool io_retry(int fd, short events)
+{
+    io_retries++;
+    if (errno == EINTR) {
+        return true;
+    }
+    return io_wait(fd, events) == 0;
+}
+
 /* Read exactly len bytes (Signal safe) */
 int read_n(int fd, char *buf, size_t len)
 {
@@ -12,7 +88,7 @@ int read_n(int fd, char *buf, size_t len)
 
     while (!__io_canceled && len > 0) {
         if ((rlen = read(fd, buf, len)) < 0) {
-            if (errno == EINTR || errno == EAGAIN) {
+            if ((errno == EINTR || errno == EAGAIN) && io_retry(fd, POLLIN)) {
                 SPDLOG_DEBUG("EAGAIN|EINTR = read()");
                 continue;
             }
@@ -39,7 +115,8 @@ int write_n(int fd, char *buf, size_t len)
 
     while (!__io_canceled && len > 0) {
         if ((wlen = write(fd, buf, len)) < 0) {
-            if (errno == EINTR || errno == EAGAIN) {
+            if ((errno == EINTR || errno == EAGAIN) &&
+                io_retry(fd, POLLOUT)) {
                 SPDLOG_DEBUG("EAGAIN|EINTR = write()");
                 continue;
             }
@@ -58,12 +135,12 @@ int write_n(int fd, char *buf, size_t len)
     return res;
 }
 
-/* Functions to read/write frames. */
-ssize_t frame_write(int fd, char *buf, size_t len)
+/* Write one frame, flags go into the length header */
+static ssize_t frame_writev(int fd, char *buf, size_t len, uint16_t flags)
 {
     struct iovec iv[2];
     ssize_t flen = (len & ETHER_FRAME_LEN_MASK) + sizeof(uint16_t);
-    uint16_t hdr = htons(len); // NOLINT
+    uint16_t hdr = htons(len | flags); // NOLINT
 
     /* Write frame */
     iv[0].iov_len = sizeof(uint16_t);
@@ -75,7 +152,8 @@ ssize_t frame_write(int fd, char *buf, size_t len)
         ssize_t wlen;
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
         if ((wlen = writev(fd, iv, 2)) < 0) {
-            if (errno == EAGAIN || errno == EINTR) {
+            if ((errno == EAGAIN || errno == EINTR) &&
+                io_retry(fd, POLLOUT)) {
                 SPDLOG_DEBUG("EAGAIN|EINTR = writev()");
                 continue;
             }
@@ -100,6 +178,32 @@ ssize_t frame_write(int fd, char *buf, size_t len)
     return 0;
 }
 
+/* Functions to read/write frames. */
+ssize_t frame_write(int fd, char *buf, size_t len)
+{
+    return frame_writev(fd, buf, len, 0);
+}
+
+ssize_t frame_write_segmented(int fd, char *buf, size_t len)
+{
+    ssize_t total = 0;
+    do {
+        size_t piece = std::min<size_t>(len, ETHER_FRAME_LEN_MASK);
+        ssize_t wlen = frame_writev(fd, buf, piece,
+                                    (piece < len) ? ETHER_FRAME_MORE : 0);
+        if (wlen <= 0) {
+            return wlen;
+        }
+
+        total += wlen;
+        // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        buf += piece;
+        len -= piece;
+    } while (len > 0);
+
+    return total;
+}
+
 ssize_t frame_read(int fd, char *buf, size_t len)
 {
     uint16_t hdr;
@@ -115,11 +219,11 @@ ssize_t frame_read(int fd, char *buf, size_t len)
         ssize_t rlen;
         // NOLINTNEXTLINE(cppcoreguidelines-pro-bounds-array-to-pointer-decay)
         if ((rlen = readv(fd, iv, 2)) < 0) {
-            if (errno == EAGAIN || errno == EINTR) {
+            if ((errno == EAGAIN || errno == EINTR) && io_retry(fd, POLLIN)) {
                 SPDLOG_DEBUG("EAGAIN|EINTR = readv()");
                 continue;
             }
-            return rlen;
+            return -1;
         }
 
         hdr = ntohs(hdr); // NOLINT
@@ -156,3 +260,23 @@ int readn_t(int fd, char *buf, size_t count, time_t timeout)
 
     return read_n(fd, buf, count);
 }
+
+int pin_thread(pthread_t thread, unsigned core)
+{
+#ifdef __linux__
+    long cores = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core % static_cast<unsigned long>(cores), &cpuSet);
+    int err = pthread_setaffinity_np(thread, sizeof(cpuSet), &cpuSet);
+    if (err != 0) {
+        SPDLOG_ERROR("pthread_setaffinity_np() error({}) {}", err,
+                     strerror(err));
+    }
+    return err;
+#else
+    (void)thread;
+    (void)core;
+    return ENOSYS;
+#endif
+}